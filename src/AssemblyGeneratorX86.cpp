@@ -270,8 +270,10 @@ namespace RandomX {
 				int shift = 0;
 				while (divisor >>= 1)
 					++shift;
-				if(shift > 0)
-					asmCode << "\tshr " << regR[instr.dst] << ", " << shift << std::endl;
+				asmCode << "\tmov rax, " << regR[instr.dst] << std::endl;
+				if (shift > 0)
+					asmCode << "\tshr rax, " << shift << std::endl;
+				asmCode << "\tadd " << regR[instr.dst] << ", rax" << std::endl;
 			}
 		}	
 	}
@@ -279,6 +281,8 @@ namespace RandomX {
 	//~8.5 uOPs
 	void AssemblyGeneratorX86::h_ISDIV_C(Instruction& instr, int i) {
 		int64_t divisor = (int32_t)instr.imm32;
+		if (divisor == 0)
+			return;
 		if ((divisor & -divisor) == divisor || (divisor & -divisor) == -divisor) {
 			asmCode << "\tmov rax, " << regR[instr.dst] << std::endl;
 			// +/- power of two
@@ -301,7 +305,7 @@ namespace RandomX {
 				asmCode << "\tneg rax" << std::endl;
 			asmCode << "\tadd " << regR[instr.dst] << ", rax" << std::endl;
 		}
-		else if (divisor != 0) {
+		else {
 			magics_info mi = compute_signed_magic_info(divisor);
 			asmCode << "\tmov rax, " << mi.multiplier << std::endl;
 			asmCode << "\timul " << regR[instr.dst] << std::endl;
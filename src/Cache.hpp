@@ -29,20 +29,25 @@ namespace RandomX {
 
 	class Cache {
 	public:
-		static void* alloc(bool largePages) {
+		static Cache* alloc(bool largePages) {
+			PageSize pageSize = PageSize::Normal;
+			void* ptr;
 			if (largePages) {
-				return allocLargePagesMemory(sizeof(Cache));
+				ptr = allocLargePagesMemory(sizeof(Cache), pageSize);
 			}
 			else {
-				void* ptr = _mm_malloc(sizeof(Cache), sizeof(__m128i));
+				ptr = _mm_malloc(sizeof(Cache), sizeof(__m128i));
 				if (ptr == nullptr)
 					throw std::bad_alloc();
-				return ptr;
 			}
+			Cache* cache = new(ptr) Cache();
+			cache->largePages = largePages;
+			cache->pageSize = pageSize;
+			return cache;
 		}
-		static void dealloc(Cache* cache, bool largePages) {
-			if (largePages) {
-				//allocLargePagesMemory(sizeof(Cache));
+		static void dealloc(Cache* cache) {
+			if (cache->largePages) {
+				freeLargePagesMemory(cache, sizeof(Cache), cache->pageSize);
 			}
 			else {
 				_mm_free(cache);
@@ -69,9 +74,15 @@ namespace RandomX {
 		const uint8_t* getCache() const {
 			return memory;
 		}
+
+		PageSize getPageSize() const {
+			return pageSize;
+		}
 	private:
 		alignas(16) KeysContainer keys;
 		uint8_t memory[CacheSize];
+		bool largePages;
+		PageSize pageSize;
 		void argonFill(const void* seed, size_t seedSize);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace RandomX {
+
+	/*
+		Lets a controlling thread abandon the work that hashing threads have
+		started for a stale job. A worker takes a snapshot before it starts a
+		hash and checks it between chain programs, so a cancellation is noticed
+		within one program execution. The counter has a cache line of its own,
+		because it is polled by all hashing threads.
+	*/
+	class CancellationToken {
+	public:
+		CancellationToken() : generation(0) {}
+		uint32_t snapshot() const {
+			return generation.load(std::memory_order_acquire);
+		}
+		bool isCancelled(uint32_t snapshot) const {
+			return generation.load(std::memory_order_relaxed) != snapshot;
+		}
+		//cancels all work started before this call
+		void cancel() {
+			generation.fetch_add(1, std::memory_order_acq_rel);
+		}
+	private:
+		alignas(64) std::atomic<uint32_t> generation;
+		char padding[64 - sizeof(std::atomic<uint32_t>)];
+	};
+
+}
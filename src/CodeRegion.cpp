@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "CodeRegion.hpp"
+
+namespace RandomX {
+
+	constexpr size_t CodeRegionAlignment = 2 * 1024 * 1024;
+
+	CodeRegion::CodeRegion(unsigned slotCount, uint32_t slotSize, bool largePages, bool dualMapped) : slotSize(slotSize) {
+		size = ((size_t)slotCount * slotSize + CodeRegionAlignment - 1) / CodeRegionAlignment * CodeRegionAlignment;
+		writable = executable = nullptr;
+		if (!dualMapped) {
+			void* memory = allocPagedMemory(size, largePages, pageSize);
+			if (setPagesExecutable(memory, size)) {
+				writable = executable = (uint8_t*)memory;
+			}
+			else {
+				freeLargePagesMemory(memory, size, pageSize);
+			}
+		}
+		if (writable == nullptr) {
+			void *rw, *rx;
+			allocDualMappedMemory(size, rw, rx, largePages, pageSize);
+			writable = (uint8_t*)rw;
+			executable = (uint8_t*)rx;
+		}
+		//slots that fit into the rounded up region are usable too
+		slotCount = size / slotSize;
+		freeSlots.reserve(slotCount);
+		for (unsigned i = slotCount; i > 0; --i) {
+			freeSlots.push_back(i - 1);
+		}
+	}
+
+	CodeRegion::~CodeRegion() {
+		if (isDualMapped()) {
+			freeDualMappedMemory(writable, executable, size);
+		}
+		else {
+			freeLargePagesMemory(writable, size, pageSize);
+		}
+	}
+
+	bool CodeRegion::acquire(CodeBuffer& buffer) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (freeSlots.empty())
+			return false;
+		size_t offset = (size_t)freeSlots.back() * slotSize;
+		freeSlots.pop_back();
+		buffer.writable = writable + offset;
+		buffer.executable = executable + offset;
+		return true;
+	}
+
+	void CodeRegion::release(const CodeBuffer& buffer) {
+		std::lock_guard<std::mutex> lock(mutex);
+		freeSlots.push_back((buffer.writable - writable) / slotSize);
+	}
+}
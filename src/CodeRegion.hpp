@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "virtualMemory.hpp"
+
+namespace RandomX {
+
+	struct CodeBuffer {
+		uint8_t* writable;   //view used for code generation
+		uint8_t* executable; //view used to run the code, same as 'writable' unless dual mapped
+	};
+
+	/*
+		A single executable region shared by the JIT compilers of all threads.
+		The region is split into slots of 'slotSize' bytes. With large pages,
+		the code of up to 32 VMs (64 KiB each) and their copies of the static
+		prologue/epilogue are covered by one 2 MiB iTLB entry.
+		If the OS refuses writable and executable memory (or dualMapped is
+		requested), the region is mapped twice with RW and RX views.
+	*/
+	class CodeRegion {
+	public:
+		CodeRegion(unsigned slotCount, uint32_t slotSize, bool largePages, bool dualMapped = false);
+		~CodeRegion();
+		bool acquire(CodeBuffer&);
+		void release(const CodeBuffer&);
+		PageSize getPageSize() const {
+			return pageSize;
+		}
+		bool isDualMapped() const {
+			return writable != executable;
+		}
+	private:
+		uint8_t* writable;
+		uint8_t* executable;
+		size_t size;
+		uint32_t slotSize;
+		PageSize pageSize;
+		std::vector<unsigned> freeSlots;
+		std::mutex mutex;
+	};
+}
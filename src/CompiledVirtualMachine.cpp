@@ -23,8 +23,9 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 
 namespace RandomX {
 
-	CompiledVirtualMachine::CompiledVirtualMachine() {
+	CompiledVirtualMachine::CompiledVirtualMachine(CodeRegion* codeRegion, bool dualMappedCode) : compiler(codeRegion, dualMappedCode) {
 		totalSize = 0;
+		iterations = InstructionCount;
 	}
 
 	void CompiledVirtualMachine::setDataset(dataset_t ds) {
@@ -39,7 +40,7 @@ namespace RandomX {
 	void CompiledVirtualMachine::execute() {
 		//executeProgram(reg, mem, scratchpad, InstructionCount);
 		totalSize += compiler.getCodeSize();
-		compiler.getProgramFunc()(reg, mem, scratchpad, InstructionCount);
+		compiler.getProgramFunc()(reg, mem, scratchpad, iterations);
 #ifdef TRACEVM
 		for (int32_t i = InstructionCount - 1; i >= 0; --i) {
 			std::cout << std::hex << tracepad[i].u64 << std::endl;
@@ -37,21 +37,59 @@ namespace RandomX {
 		void operator delete(void* ptr) {
 			_mm_free(ptr);
 		}
-		CompiledVirtualMachine();
+		CompiledVirtualMachine(CodeRegion* codeRegion = nullptr, bool dualMappedCode = false);
 		void setDataset(dataset_t ds) override;
 		void initialize() override;
 		virtual void execute() override;
+		size_t getCodeSize() override {
+			return compiler.getCodeSize();
+		}
 		void* getProgram() {
 			return compiler.getCode();
 		}
+		void setScheduling(bool enabled) {
+			compiler.setScheduling(enabled);
+		}
+		void setInstructionCosts(const InstructionCosts& costs) {
+			compiler.setInstructionCosts(costs);
+		}
+		void setRenaming(bool enabled) {
+			compiler.setRenaming(enabled);
+		}
+		void setPrefetching(bool enabled) {
+			compiler.setPrefetching(enabled);
+		}
+		void setInstructionSets(bool avx, bool bmi2) {
+			compiler.setInstructionSets(avx, bmi2);
+		}
+		void setCodeLayout(const CodeLayout& layout) {
+			compiler.setCodeLayout(layout);
+		}
+		void setPerfLog(PerfJitLog* log) {
+			compiler.setPerfLog(log);
+		}
+		const char* getCodeLayoutName() {
+			return compiler.getCodeLayout().name;
+		}
+		const char* getInstructionSets() {
+			return compiler.usesAvx() ? (compiler.usesBmi2() ? "AVX and BMI2" : "AVX") : (compiler.usesBmi2() ? "SSE2 and BMI2" : "SSE2");
+		}
+		bool isCodeDualMapped() {
+			return compiler.isDualMapped();
+		}
 		uint64_t getTotalSize() {
 			return totalSize;
 		}
+		//loop iterations of execute(), InstructionCount unless changed for testing
+		void setIterations(uint32_t count) {
+			iterations = count;
+		}
 	private:
 #ifdef TRACEVM
 		convertible_t tracepad[InstructionCount];
 #endif
 		JitCompilerX86 compiler;
 		uint64_t totalSize;
+		uint32_t iterations;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,266 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Replays a program corpus written by 'randomx --capture' through the VM
+	engines. Every program starts from its captured state and its result is
+	checked, so code generation changes can be timed and verified on exactly
+	the same workload.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Stopwatch.hpp"
+#include "common.hpp"
+#include "intrinPortable.h"
+#include "Cache.hpp"
+#include "dataset.hpp"
+#include "hashAes1Rx4.hpp"
+#include "ProgramCorpus.hpp"
+#include "CompiledVirtualMachine.hpp"
+#include "InterpretedVirtualMachine.hpp"
+
+struct Options {
+	std::string corpusPath;
+	std::string engines;
+	bool help;
+	bool fullDataset;
+	int reps;
+};
+
+struct Engine {
+	const char* name;
+	bool compiled;
+	std::function<void(RandomX::CompiledVirtualMachine*)> configure;
+};
+
+static const Engine engines[] = {
+	{ "interpreted", false, nullptr },
+	{ "compiled", true, [](RandomX::CompiledVirtualMachine*) {} },
+	{ "scheduled", true, [](RandomX::CompiledVirtualMachine* vm) { vm->setScheduling(true); } },
+	{ "sse2", true, [](RandomX::CompiledVirtualMachine* vm) { vm->setInstructionSets(false, false); } },
+	{ "noRename", true, [](RandomX::CompiledVirtualMachine* vm) { vm->setRenaming(false); } },
+	{ "noPrefetch", true, [](RandomX::CompiledVirtualMachine* vm) { vm->setPrefetching(false); } },
+};
+
+struct ReplayResult {
+	double initializeNs; //per program, best of all reps
+	double executeNs;
+	int mismatches; //programs whose result differs from the reference
+	int stateErrors; //programs whose ma and mx differ from the corpus after initialize()
+	std::vector<std::string> results;
+};
+
+static void readOptions(int argc, char** argv, Options& options) {
+	options.help = false;
+	options.fullDataset = false;
+	options.reps = 3;
+	options.engines = "interpreted,compiled,scheduled";
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--engines" && hasValue)
+			options.engines = argv[++i];
+		else if (arg == "--help")
+			options.help = true;
+		else if (arg == "--fullDataset")
+			options.fullDataset = true;
+		else if (arg == "--reps" && hasValue)
+			options.reps = std::max(1, atoi(argv[++i]));
+		else if (arg.compare(0, 2, "--") != 0 && options.corpusPath.empty())
+			options.corpusPath = arg;
+		else
+			throw std::runtime_error("Unknown option " + arg);
+	}
+	if (!options.help && options.corpusPath.empty())
+		throw std::runtime_error("No corpus file given");
+}
+
+static void printUsage(const char* executable) {
+	std::cout << "Usage: " << executable << " [OPTIONS] CORPUS" << std::endl;
+	std::cout << "  --engines L     comma separated engines to replay the corpus with" << std::endl;
+	std::cout << "                  (default: interpreted,compiled,scheduled), available:" << std::endl;
+	std::cout << "                  ";
+	for (const Engine& engine : engines)
+		std::cout << engine.name << " ";
+	std::cout << std::endl;
+	std::cout << "  --reps N        replays per engine, the fastest is reported (default: 3)" << std::endl;
+	std::cout << "  --fullDataset   initialize the 4 GiB dataset, so that the results of" << std::endl;
+	std::cout << "                  compiled engines can be checked against the corpus" << std::endl;
+}
+
+static const Engine& findEngine(const std::string& name) {
+	for (const Engine& engine : engines) {
+		if (name == engine.name)
+			return engine;
+	}
+	throw std::runtime_error("Unknown engine " + name);
+}
+
+static ReplayResult replay(RandomX::VirtualMachine* vm, const RandomX::ProgramCorpus& corpus, int reps) {
+	ReplayResult r;
+	r.initializeNs = r.executeNs = 1e300;
+	r.mismatches = r.stateErrors = 0;
+	size_t programCount = corpus.getProgramCount();
+	uint8_t* scratchpad = (uint8_t*)_mm_malloc(RandomX::ScratchpadSize, 64);
+	if (scratchpad == nullptr)
+		throw std::bad_alloc();
+	vm->setScratchpad(scratchpad);
+	for (int rep = 0; rep < reps; ++rep) {
+		double initializeNs = 0, executeNs = 0;
+		r.results.clear();
+		r.stateErrors = 0;
+		for (const RandomX::CorpusHash& hash : corpus.getHashes()) {
+			alignas(16) uint64_t seed[8];
+			memcpy(seed, hash.scratchpadSeed, sizeof(seed));
+			fillAes1Rx4<false>(seed, RandomX::ScratchpadSize, scratchpad);
+			for (const RandomX::CorpusProgram& p : hash.programs) {
+				*vm->getProgramBuffer() = p.program;
+				Stopwatch sw(true);
+				vm->initialize();
+				initializeNs += sw.getElapsed() * 1e9;
+				if (vm->getMemoryRegisters().ma != p.ma || vm->getMemoryRegisters().mx != p.mx)
+					r.stateErrors++;
+				vm->setRegisterFile(p.registers);
+				setRoundMode(p.roundingMode);
+				sw.restart();
+				vm->execute();
+				executeNs += sw.getElapsed() * 1e9;
+				alignas(16) uint8_t result[RandomX::ResultSize];
+				vm->getResult<false>(nullptr, 0, result);
+				r.results.push_back(std::string((char*)result, sizeof(result)));
+			}
+		}
+		r.initializeNs = std::min(r.initializeNs, initializeNs / programCount);
+		r.executeNs = std::min(r.executeNs, executeNs / programCount);
+	}
+	initFpu();
+	_mm_free(scratchpad);
+	return r;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	try {
+		readOptions(argc, argv, options);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (options.help) {
+		printUsage(argv[0]);
+		return 0;
+	}
+
+	int failures = 0;
+	try {
+		std::vector<const Engine*> selected;
+		std::istringstream names(options.engines);
+		std::string name;
+		while (std::getline(names, name, ','))
+			selected.push_back(&findEngine(name));
+
+		RandomX::ProgramCorpus corpus;
+		corpus.load(options.corpusPath);
+		std::vector<std::string> captured;
+		for (const RandomX::CorpusHash& hash : corpus.getHashes()) {
+			for (const RandomX::CorpusProgram& p : hash.programs)
+				captured.push_back(std::string((const char*)p.result, sizeof(p.result)));
+		}
+		std::cout << "Corpus: " << corpus.getHashes().size() << " hashes, " << captured.size() << " programs" << std::endl;
+		if (captured.empty())
+			return 0;
+
+		RandomX::dataset_t cache, dataset;
+		RandomX::datasetInitCache<false>(corpus.getCacheSeed(), cache, false);
+		PageSize pageSize;
+		RandomX::datasetAlloc(dataset, false, pageSize);
+		if (options.fullDataset) {
+			std::cout << "Initializing the dataset..." << std::endl;
+			RandomX::datasetInit<false>(cache.cache, dataset, 0, RandomX::DatasetBlockCount);
+		}
+		/*
+			Without --fullDataset the dataset pages are not backed and every read
+			returns zeros, so the compiled engines are checked against the first
+			compiled engine instead of the corpus.
+		*/
+		const std::vector<std::string>* compiledReference = options.fullDataset ? &captured : nullptr;
+		std::vector<std::string> firstCompiled;
+
+		std::cout << std::left << std::setw(14) << "engine" << std::right << std::setw(14) << "init us/prog";
+		std::cout << std::setw(14) << "exec us/prog" << std::setw(12) << "mismatches" << "  checked against" << std::endl;
+		for (const Engine* engine : selected) {
+			RandomX::VirtualMachine* vm;
+			if (engine->compiled) {
+				RandomX::CompiledVirtualMachine* cvm = new RandomX::CompiledVirtualMachine();
+				engine->configure(cvm);
+				cvm->setDataset(dataset);
+				vm = cvm;
+			}
+			else {
+				vm = new RandomX::InterpretedVirtualMachine(false, false);
+				vm->setDataset(cache);
+			}
+			ReplayResult r = replay(vm, corpus, options.reps);
+			delete vm;
+			const std::vector<std::string>* reference = &captured;
+			const char* referenceName = "corpus";
+			if (engine->compiled && compiledReference == nullptr) {
+				firstCompiled = r.results;
+				compiledReference = &firstCompiled;
+				reference = nullptr;
+				referenceName = "-";
+			}
+			else if (engine->compiled) {
+				reference = compiledReference;
+				referenceName = options.fullDataset ? "corpus" : "first compiled";
+			}
+			if (reference != nullptr) {
+				for (size_t i = 0; i < r.results.size(); ++i) {
+					if (r.results[i] != (*reference)[i])
+						r.mismatches++;
+				}
+			}
+			std::cout << std::left << std::setw(14) << engine->name << std::right << std::fixed << std::setprecision(2);
+			std::cout << std::setw(14) << r.initializeNs / 1000 << std::setw(14) << r.executeNs / 1000;
+			std::cout << std::setw(12) << r.mismatches << "  " << referenceName << std::endl;
+			if (r.stateErrors > 0)
+				std::cout << "  " << r.stateErrors << " programs start from a different ma/mx than captured" << std::endl;
+			if (r.mismatches > 0 || r.stateErrors > 0)
+				failures++;
+		}
+		_mm_free(dataset.dataset);
+		RandomX::Cache::dealloc(cache.cache);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return failures > 0 ? 2 : 0;
+}
@@ -0,0 +1,353 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Compares the code of JitCompilerX86 with an optimizing compiler. The
+	programs of a corpus written by 'randomx --capture' are translated to C++
+	by CxxGeneratorX86, compiled into a shared library and executed from the
+	same state as the JIT code. The results must be identical; the cycles of
+	each program show where the JIT falls behind the compiler.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+#include "Stopwatch.hpp"
+#include "common.hpp"
+#include "intrinPortable.h"
+#include "dataset.hpp"
+#include "virtualMemory.hpp"
+#include "hashAes1Rx4.hpp"
+#include "ProgramCorpus.hpp"
+#include "CxxGeneratorX86.hpp"
+#include "CompiledVirtualMachine.hpp"
+
+struct Options {
+	std::string corpusPath;
+	std::string sourcePath;
+	std::string includePath;
+	std::string compiler;
+	std::string flags;
+	bool help;
+	bool schedule;
+	bool sse2;
+	bool noRename;
+	bool noPrefetch;
+	int hashes;
+	int reps;
+	int top;
+};
+
+//runs the functions compiled from the generated source
+class CxxVirtualMachine : public RandomX::VirtualMachine {
+public:
+	CxxVirtualMachine() : func(nullptr) {}
+	void setDataset(RandomX::dataset_t ds) override {
+		mem.ds = ds;
+	}
+	void setProgramFunc(RandomX::ProgramFunc f) {
+		func = f;
+	}
+	void execute() override {
+		func(reg, mem, scratchpad, RandomX::InstructionCount);
+	}
+private:
+	RandomX::ProgramFunc func;
+};
+
+struct EngineRun {
+	std::vector<uint64_t> cycles; //per program, fastest of all reps
+	std::vector<std::string> results;
+};
+
+static void readOptions(int argc, char** argv, Options& options) {
+	options.help = false;
+	options.schedule = options.sse2 = options.noRename = options.noPrefetch = false;
+	options.sourcePath = "cxxbench.cpp";
+	options.includePath = "src";
+	const char* cxx = getenv("CXX");
+	options.compiler = cxx != nullptr ? cxx : "g++";
+	options.flags = "-O3 -march=native -flto";
+	options.hashes = 2;
+	options.reps = 5;
+	options.top = 5;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--help")
+			options.help = true;
+		else if (arg == "--hashes" && hasValue)
+			options.hashes = std::max(1, atoi(argv[++i]));
+		else if (arg == "--reps" && hasValue)
+			options.reps = std::max(1, atoi(argv[++i]));
+		else if (arg == "--top" && hasValue)
+			options.top = std::max(0, atoi(argv[++i]));
+		else if (arg == "--source" && hasValue)
+			options.sourcePath = argv[++i];
+		else if (arg == "--include" && hasValue)
+			options.includePath = argv[++i];
+		else if (arg == "--cxx" && hasValue)
+			options.compiler = argv[++i];
+		else if (arg == "--flags" && hasValue)
+			options.flags = argv[++i];
+		else if (arg == "--schedule")
+			options.schedule = true;
+		else if (arg == "--sse2")
+			options.sse2 = true;
+		else if (arg == "--noRename")
+			options.noRename = true;
+		else if (arg == "--noPrefetch")
+			options.noPrefetch = true;
+		else if (arg.compare(0, 2, "--") != 0 && options.corpusPath.empty())
+			options.corpusPath = arg;
+		else
+			throw std::runtime_error("Unknown option " + arg);
+	}
+	if (!options.help && options.corpusPath.empty())
+		throw std::runtime_error("No corpus file given");
+}
+
+static void printUsage(const char* executable) {
+	std::cout << "Usage: " << executable << " [OPTIONS] CORPUS" << std::endl;
+	std::cout << "  --hashes N      compile the programs of the first N hashes (default: 2)" << std::endl;
+	std::cout << "  --reps N        executions of each program, the fastest is reported (default: 5)" << std::endl;
+	std::cout << "  --top N         list the N programs with the largest JIT deficit (default: 5)" << std::endl;
+	std::cout << "  --source F      generated source file (default: cxxbench.cpp)," << std::endl;
+	std::cout << "                  the library is written next to it with the extension .so" << std::endl;
+	std::cout << "  --include D     directory of common.hpp and instructionsPortable.cpp (default: src)" << std::endl;
+	std::cout << "  --cxx C         compiler (default: $CXX or g++)" << std::endl;
+	std::cout << "  --flags F       optimization flags (default: -O3 -march=native -flto)" << std::endl;
+	std::cout << "  --schedule      compare with the scheduled JIT code" << std::endl;
+	std::cout << "  --sse2          compare with JIT code without AVX and BMI2" << std::endl;
+	std::cout << "  --noRename      compare with JIT code without register renaming" << std::endl;
+	std::cout << "  --noPrefetch    compare with JIT code without scratchpad prefetches" << std::endl;
+}
+
+static std::string libraryPath(const std::string& sourcePath) {
+	std::string path = sourcePath;
+	size_t dot = path.find_last_of('.');
+	if (dot != std::string::npos && path.find('/', dot) == std::string::npos)
+		path.erase(dot);
+	path += ".so";
+	//dlopen searches the library path for names without a slash
+	if (path.find('/') == std::string::npos)
+		path = "./" + path;
+	return path;
+}
+
+static std::string functionName(size_t index) {
+	return "rx_program_" + std::to_string(index);
+}
+
+static void generateSource(const Options& options, const std::vector<const RandomX::CorpusProgram*>& programs) {
+	std::ofstream source(options.sourcePath);
+	if (!source)
+		throw std::runtime_error("Cannot write " + options.sourcePath);
+	RandomX::CxxGeneratorX86 generator;
+	RandomX::CxxGeneratorX86::generateHeader(source);
+	for (size_t i = 0; i < programs.size(); ++i) {
+		RandomX::Program program = programs[i]->program;
+		generator.generateProgram(program, functionName(i));
+		generator.printCode(source);
+	}
+	if (!source)
+		throw std::runtime_error("Cannot write " + options.sourcePath);
+}
+
+/*
+	The VM functions change the rounding mode, so the compiler must not assume
+	round to nearest (-frounding-math) and must not fuse multiplications and
+	additions that the JIT executes separately (-ffp-contract=off).
+	instructionsPortable.cpp is compiled into the library, so that mulh, rotr,
+	condition etc. are inlined with -flto.
+*/
+static double compileSource(const Options& options, const std::string& library) {
+	std::string command = options.compiler + " " + options.flags;
+	command += " -std=c++11 -shared -fPIC -fvisibility=hidden -frounding-math -ffp-contract=off";
+	command += " -I" + options.includePath + " " + options.sourcePath + " " + options.includePath + "/instructionsPortable.cpp";
+	command += " -o " + library;
+	std::cout << command << std::endl;
+	Stopwatch sw(true);
+	if (std::system(command.c_str()) != 0)
+		throw std::runtime_error("Compilation of " + options.sourcePath + " failed");
+	return sw.getElapsed();
+}
+
+static EngineRun run(RandomX::VirtualMachine* vm, const std::vector<const RandomX::CorpusHash*>& hashes, size_t programCount, int reps, const std::vector<RandomX::ProgramFunc>* funcs) {
+	EngineRun r;
+	r.cycles.assign(programCount, UINT64_MAX);
+	uint8_t* scratchpad = (uint8_t*)_mm_malloc(RandomX::ScratchpadSize, 64);
+	if (scratchpad == nullptr)
+		throw std::bad_alloc();
+	vm->setScratchpad(scratchpad);
+	for (int rep = 0; rep < reps; ++rep) {
+		r.results.clear();
+		size_t index = 0;
+		for (const RandomX::CorpusHash* hash : hashes) {
+			alignas(16) uint64_t seed[8];
+			memcpy(seed, hash->scratchpadSeed, sizeof(seed));
+			fillAes1Rx4<false>(seed, RandomX::ScratchpadSize, scratchpad);
+			initFpu();
+			for (const RandomX::CorpusProgram& p : hash->programs) {
+				*vm->getProgramBuffer() = p.program;
+				vm->initialize();
+				if (funcs != nullptr)
+					static_cast<CxxVirtualMachine*>(vm)->setProgramFunc((*funcs)[index]);
+				vm->setRegisterFile(p.registers);
+				setRoundMode(p.roundingMode);
+				uint64_t start = __rdtsc();
+				vm->execute();
+				uint64_t cycles = __rdtsc() - start;
+				r.cycles[index] = std::min(r.cycles[index], cycles);
+				alignas(16) uint8_t result[RandomX::ResultSize];
+				vm->getResult<false>(nullptr, 0, result);
+				r.results.push_back(std::string((char*)result, sizeof(result)));
+				index++;
+			}
+		}
+	}
+	initFpu();
+	_mm_free(scratchpad);
+	return r;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	try {
+		readOptions(argc, argv, options);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (options.help) {
+		printUsage(argv[0]);
+		return 0;
+	}
+
+	int mismatches = 0;
+	try {
+		RandomX::ProgramCorpus corpus;
+		corpus.load(options.corpusPath);
+		std::vector<const RandomX::CorpusHash*> hashes;
+		std::vector<const RandomX::CorpusProgram*> programs;
+		for (const RandomX::CorpusHash& hash : corpus.getHashes()) {
+			if (hashes.size() == (size_t)options.hashes)
+				break;
+			hashes.push_back(&hash);
+			for (const RandomX::CorpusProgram& p : hash.programs)
+				programs.push_back(&p);
+		}
+		std::cout << "Corpus: " << corpus.getHashes().size() << " hashes, comparing " << programs.size() << " programs of " << hashes.size() << " hashes" << std::endl;
+		if (programs.empty())
+			return 0;
+
+		generateSource(options, programs);
+		std::string library = libraryPath(options.sourcePath);
+		double compileTime = compileSource(options, library);
+		std::cout << "Compiled " << programs.size() << " programs in " << std::fixed << std::setprecision(2) << compileTime << " s" << std::endl;
+		void* handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (handle == nullptr)
+			throw std::runtime_error(std::string("Cannot load ") + library + ": " + dlerror());
+		std::vector<RandomX::ProgramFunc> funcs;
+		for (size_t i = 0; i < programs.size(); ++i) {
+			void* f = dlsym(handle, functionName(i).c_str());
+			if (f == nullptr)
+				throw std::runtime_error("Missing function " + functionName(i) + " in " + library);
+			funcs.push_back((RandomX::ProgramFunc)f);
+		}
+
+		/*
+			Both engines read the same unbacked dataset, which returns zeros, so
+			their results are compared with each other rather than with the corpus.
+		*/
+		RandomX::dataset_t dataset;
+		PageSize pageSize;
+		RandomX::datasetAlloc(dataset, false, pageSize);
+
+		RandomX::CompiledVirtualMachine jitVm;
+		jitVm.setScheduling(options.schedule);
+		jitVm.setRenaming(!options.noRename);
+		jitVm.setPrefetching(!options.noPrefetch);
+		if (options.sse2)
+			jitVm.setInstructionSets(false, false);
+		jitVm.setDataset(dataset);
+		EngineRun jit = run(&jitVm, hashes, programs.size(), options.reps, nullptr);
+
+		CxxVirtualMachine cxxVm;
+		cxxVm.setDataset(dataset);
+		EngineRun cxx = run(&cxxVm, hashes, programs.size(), options.reps, &funcs);
+
+		std::vector<double> ratios;
+		double logSum = 0, jitTotal = 0, cxxTotal = 0;
+		for (size_t i = 0; i < programs.size(); ++i) {
+			double ratio = (double)cxx.cycles[i] / jit.cycles[i];
+			ratios.push_back(ratio);
+			logSum += std::log(ratio);
+			jitTotal += jit.cycles[i];
+			cxxTotal += cxx.cycles[i];
+			if (jit.results[i] != cxx.results[i]) {
+				std::cout << "  " << functionName(i) << ": result differs from the JIT" << std::endl;
+				mismatches++;
+			}
+		}
+		std::cout << std::left << std::setw(14) << "engine" << std::right << std::setw(16) << "kcycles/prog" << std::setw(16) << "cycles/iter" << std::endl;
+		std::cout << std::left << std::setw(14) << "jit" << std::right << std::setw(16) << jitTotal / programs.size() / 1000;
+		std::cout << std::setw(16) << jitTotal / programs.size() / RandomX::InstructionCount << std::endl;
+		std::cout << std::left << std::setw(14) << "cxx" << std::right << std::setw(16) << cxxTotal / programs.size() / 1000;
+		std::cout << std::setw(16) << cxxTotal / programs.size() / RandomX::InstructionCount << std::endl;
+		std::cout << "cxx/jit: geometric mean " << std::setprecision(3) << std::exp(logSum / programs.size());
+		std::cout << ", min " << *std::min_element(ratios.begin(), ratios.end());
+		std::cout << ", max " << *std::max_element(ratios.begin(), ratios.end());
+		std::cout << ", " << std::count_if(ratios.begin(), ratios.end(), [](double x) { return x < 1; }) << " of " << ratios.size() << " programs faster with " << options.compiler << std::endl;
+		if (mismatches > 0)
+			std::cout << mismatches << " programs differ from the JIT" << std::endl;
+
+		std::vector<size_t> order(programs.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ratios[a] < ratios[b]; });
+		size_t top = std::min((size_t)options.top, order.size());
+		if (top > 0)
+			std::cout << "Largest JIT deficits (functions in " << options.sourcePath << "):" << std::endl;
+		for (size_t i = 0; i < top; ++i) {
+			size_t index = order[i];
+			std::cout << "  " << std::left << std::setw(16) << functionName(index) << std::right << std::setprecision(1);
+			std::cout << std::setw(10) << jit.cycles[index] / (double)RandomX::InstructionCount << " jit";
+			std::cout << std::setw(10) << cxx.cycles[index] / (double)RandomX::InstructionCount << " cxx cycles/iter" << std::endl;
+		}
+
+		_mm_free(dataset.dataset);
+		dlclose(handle);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return mismatches > 0 ? 2 : 0;
+}
@@ -0,0 +1,448 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "CxxGeneratorX86.hpp"
+#include "common.hpp"
+#include "intrinPortable.h"
+#include "Program.hpp"
+
+namespace RandomX {
+
+	static const char* regR[8] = { "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7" };
+	static const char* regFE[8] = { "f0", "f1", "f2", "f3", "e0", "e1", "e2", "e3" };
+	static const char* regF[4] = { "f0", "f1", "f2", "f3" };
+	static const char* regE[4] = { "e0", "e1", "e2", "e3" };
+	static const char* regA[4] = { "a0", "a1", "a2", "a3" };
+
+	static std::string hex(uint64_t x) {
+		std::stringstream ss;
+		ss << "0x" << std::hex << x << "ULL";
+		return ss.str();
+	}
+
+	static inline int addressMask(Instruction& instr) {
+		return (instr.mod % 4) ? ScratchpadL1Mask : ScratchpadL2Mask;
+	}
+
+	static inline int addressMask16(Instruction& instr) {
+		return (instr.mod % 4) ? ScratchpadL1Mask16 : ScratchpadL2Mask16;
+	}
+
+	void CxxGeneratorX86::generateHeader(std::ostream& os) {
+		os << "//generated by CxxGeneratorX86" << std::endl;
+		os << "#include <utility>" << std::endl;
+		os << "#include \"common.hpp\"" << std::endl;
+		os << "#include \"intrinPortable.h\"" << std::endl;
+		os << std::endl;
+		os << "#if defined(_MSC_VER)" << std::endl;
+		os << "#define RX_EXPORT extern \"C\" __declspec(dllexport)" << std::endl;
+		os << "#else" << std::endl;
+		os << "#define RX_EXPORT extern \"C\" __attribute__((visibility(\"default\")))" << std::endl;
+		os << "#endif" << std::endl;
+		os << std::endl;
+		//compilers don't order floating point arithmetic with respect to MXCSR writes, even with -frounding-math
+		os << "#if defined(_MSC_VER)" << std::endl;
+		os << "#define RX_FPU_BARRIER()" << std::endl;
+		os << "#else" << std::endl;
+		os << "#define RX_FPU_BARRIER() asm volatile(\"\" : \"+x\"(f0), \"+x\"(f1), \"+x\"(f2), \"+x\"(f3), \"+x\"(e0), \"+x\"(e1), \"+x\"(e2), \"+x\"(e3))" << std::endl;
+		os << "#endif" << std::endl;
+		os << std::endl;
+		os << "using namespace RandomX;" << std::endl;
+	}
+
+	/*
+		The function follows the VM loop of JitCompilerX86: the scratchpad addresses
+		of an iteration are the low and high halves of r[readReg0] ^ r[readReg1]
+		(^ ma:mx in the first iteration) and the dataset is read from mem.ds.dataset.
+	*/
+	void CxxGeneratorX86::generateProgram(Program& prog, const std::string& name) {
+		cxxCode.str(std::string()); //clear
+		auto addressRegisters = prog.getEntropy(12);
+		uint32_t readReg0 = 0 + (addressRegisters & 1);
+		addressRegisters >>= 1;
+		uint32_t readReg1 = 2 + (addressRegisters & 1);
+		addressRegisters >>= 1;
+		uint32_t readReg2 = 4 + (addressRegisters & 1);
+		addressRegisters >>= 1;
+		uint32_t readReg3 = 6 + (addressRegisters & 1);
+
+		cxxCode << std::endl;
+		cxxCode << "RX_EXPORT void " << name << "(RegisterFile& reg, MemoryRegisters& mem, uint8_t* scratchpad, uint64_t iterations) {" << std::endl;
+		cxxCode << "\tuint64_t r0 = 0, r1 = 0, r2 = 0, r3 = 0, r4 = 0, r5 = 0, r6 = 0, r7 = 0;" << std::endl;
+		cxxCode << "\t__m128d f0, f1, f2, f3, e0, e1, e2, e3;" << std::endl;
+		for (int i = 0; i < 4; ++i)
+			cxxCode << "\tconst __m128d " << regA[i] << " = _mm_load_pd(&reg.a[" << i << "].lo);" << std::endl;
+		cxxCode << "\tconst __m128d minDbl = _mm_castsi128_pd(_mm_set1_epi64x(0x0010000000000000));" << std::endl;
+		cxxCode << "\tconst __m128d signMask = _mm_castsi128_pd(_mm_set1_epi64x(0x81F0000000000000));" << std::endl;
+		cxxCode << "\tconst uint8_t* dataset = mem.ds.dataset;" << std::endl;
+		cxxCode << "\tuint32_t mx = mem.mx, ma = mem.ma;" << std::endl;
+		cxxCode << "\tuint64_t spMix = ((uint64_t)ma << 32) | mx;" << std::endl;
+		cxxCode << "\tdo {" << std::endl;
+		cxxCode << "\t\tspMix ^= " << regR[readReg0] << " ^ " << regR[readReg1] << ";" << std::endl;
+		cxxCode << "\t\tuint8_t* spAddr0 = scratchpad + ((uint32_t)spMix & ScratchpadL3Mask64);" << std::endl;
+		cxxCode << "\t\tuint8_t* spAddr1 = scratchpad + ((uint32_t)(spMix >> 32) & ScratchpadL3Mask64);" << std::endl;
+		for (int i = 0; i < RegistersCount; ++i)
+			cxxCode << "\t\t" << regR[i] << " ^= load64(spAddr0 + " << 8 * i << ");" << std::endl;
+		for (int i = 0; i < 4; ++i)
+			cxxCode << "\t\t" << regF[i] << " = load_cvt_i32x2(spAddr1 + " << 8 * i << ");" << std::endl;
+		for (int i = 0; i < 4; ++i)
+			cxxCode << "\t\t" << regE[i] << " = _mm_abs(load_cvt_i32x2(spAddr1 + " << 32 + 8 * i << "));" << std::endl;
+
+		for (unsigned i = 0; i < ProgramLength; ++i) {
+			Instruction instr = prog(i);
+			instr.src %= RegistersCount;
+			instr.dst %= RegistersCount;
+			generateCode(instr, i);
+		}
+
+		cxxCode << "\t\tmx ^= (uint32_t)(" << regR[readReg2] << " ^ " << regR[readReg3] << ");" << std::endl;
+		cxxCode << "\t\tmx &= CacheLineAlignMask;" << std::endl;
+		cxxCode << "\t\tPREFETCHNTA(dataset + mx);" << std::endl;
+		cxxCode << "\t\tconst uint8_t* datasetLine = dataset + ma;" << std::endl;
+		for (int i = 0; i < RegistersCount; ++i)
+			cxxCode << "\t\t" << regR[i] << " ^= load64(datasetLine + " << 8 * i << ");" << std::endl;
+		cxxCode << "\t\tstd::swap(mx, ma);" << std::endl;
+		cxxCode << "\t\tspMix = 0;" << std::endl;
+		for (int i = 0; i < RegistersCount; ++i)
+			cxxCode << "\t\tstore64(spAddr1 + " << 8 * i << ", " << regR[i] << ");" << std::endl;
+		//the JIT multiplies f by e in place, so the register file gets the products
+		for (int i = 0; i < 4; ++i)
+			cxxCode << "\t\t" << regF[i] << " = _mm_mul_pd(" << regF[i] << ", " << regE[i] << ");" << std::endl;
+		for (int i = 0; i < 4; ++i)
+			cxxCode << "\t\t_mm_store_pd((double*)(spAddr0 + " << 16 * i << "), " << regF[i] << ");" << std::endl;
+		cxxCode << "\t} while (--iterations != 0);" << std::endl;
+		for (int i = 0; i < RegistersCount; ++i)
+			cxxCode << "\tstore64(&reg.r[" << i << "], " << regR[i] << ");" << std::endl;
+		for (int i = 0; i < 4; ++i)
+			cxxCode << "\t_mm_store_pd(&reg.f[" << i << "].lo, " << regF[i] << ");" << std::endl;
+		for (int i = 0; i < 4; ++i)
+			cxxCode << "\t_mm_store_pd(&reg.e[" << i << "].lo, " << regE[i] << ");" << std::endl;
+		cxxCode << "}" << std::endl;
+	}
+
+	void CxxGeneratorX86::generateCode(Instruction& instr, int i) {
+		cxxCode << "\t\t//" << i << ": " << instr;
+		auto generator = engine[instr.opcode];
+		(this->*generator)(instr, i);
+	}
+
+	std::string CxxGeneratorX86::genAddressReg(Instruction& instr, int reg, int mask) {
+		std::stringstream ss;
+		ss << "scratchpad + ((uint32_t)" << regR[reg] << " & " << mask << ")";
+		return ss.str();
+	}
+
+	std::string CxxGeneratorX86::genAddressImm(Instruction& instr) {
+		std::stringstream ss;
+		ss << "scratchpad + " << (instr.imm32 & ScratchpadL3Mask);
+		return ss.str();
+	}
+
+	void CxxGeneratorX86::h_IADD_R(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " += " << regR[instr.src] << ";" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " += " << hex(signExtend2sCompl(instr.imm32)) << ";" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IADD_M(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " += load64(" << genAddressReg(instr, instr.src, addressMask(instr)) << ");" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " += load64(" << genAddressImm(instr) << ");" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IADD_RC(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regR[instr.dst] << " += " << regR[instr.src] << " + " << hex(signExtend2sCompl(instr.imm32)) << ";" << std::endl;
+	}
+
+	//the JIT subtracts the masked immediate
+	void CxxGeneratorX86::h_ISUB_R(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " -= " << regR[instr.src] << ";" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " -= " << (instr.imm32 & ScratchpadL3Mask) << ";" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_ISUB_M(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " -= load64(" << genAddressReg(instr, instr.src, addressMask(instr)) << ");" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " -= load64(" << genAddressImm(instr) << ");" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IMUL_9C(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regR[instr.dst] << " = 9 * " << regR[instr.dst] << " + " << hex(signExtend2sCompl(instr.imm32)) << ";" << std::endl;
+	}
+
+	//the JIT multiplies by the masked immediate
+	void CxxGeneratorX86::h_IMUL_R(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " *= " << regR[instr.src] << ";" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " *= " << (instr.imm32 & ScratchpadL3Mask) << ";" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IMUL_M(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " *= load64(" << genAddressReg(instr, instr.src, addressMask(instr)) << ");" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " *= load64(" << genAddressImm(instr) << ");" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IMULH_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regR[instr.dst] << " = mulh(" << regR[instr.dst] << ", " << regR[instr.src] << ");" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_IMULH_M(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " = mulh(" << regR[instr.dst] << ", load64(" << genAddressReg(instr, instr.src, addressMask(instr)) << "));" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " = mulh(" << regR[instr.dst] << ", load64(" << genAddressImm(instr) << "));" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_ISMULH_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regR[instr.dst] << " = smulh(" << regR[instr.dst] << ", " << regR[instr.src] << ");" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_ISMULH_M(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " = smulh(" << regR[instr.dst] << ", load64(" << genAddressReg(instr, instr.src, addressMask(instr)) << "));" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " = smulh(" << regR[instr.dst] << ", load64(" << genAddressImm(instr) << "));" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IDIV_C(Instruction& instr, int i) {
+		uint32_t divisor = instr.imm32;
+		if (divisor == 0)
+			return;
+		if (divisor & (divisor - 1)) {
+			cxxCode << "\t\t" << regR[instr.dst] << " += " << regR[instr.dst] << " / " << divisor << "U;" << std::endl;
+		}
+		else {
+			int shift = 0;
+			while (divisor >>= 1)
+				++shift;
+			cxxCode << "\t\t" << regR[instr.dst] << " += " << regR[instr.dst] << " >> " << shift << ";" << std::endl;
+		}
+	}
+
+	//dst + dst / -1 is zero for every dst, the division itself would trap on INT64_MIN
+	void CxxGeneratorX86::h_ISDIV_C(Instruction& instr, int i) {
+		int64_t divisor = (int32_t)instr.imm32;
+		if (divisor == 0)
+			return;
+		if (divisor == -1)
+			cxxCode << "\t\t" << regR[instr.dst] << " = 0;" << std::endl;
+		else
+			cxxCode << "\t\t" << regR[instr.dst] << " += (int64_t)" << regR[instr.dst] << " / " << divisor << "LL;" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_INEG_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regR[instr.dst] << " = 0 - " << regR[instr.dst] << ";" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_IXOR_R(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " ^= " << regR[instr.src] << ";" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " ^= " << hex(signExtend2sCompl(instr.imm32)) << ";" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IXOR_M(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " ^= load64(" << genAddressReg(instr, instr.src, addressMask(instr)) << ");" << std::endl;
+		}
+		else {
+			cxxCode << "\t\t" << regR[instr.dst] << " ^= load64(" << genAddressImm(instr) << ");" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IROR_R(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " = rotr(" << regR[instr.dst] << ", " << regR[instr.src] << " & 63);" << std::endl;
+		}
+		else if (instr.imm32 & 63) {
+			cxxCode << "\t\t" << regR[instr.dst] << " = rotr(" << regR[instr.dst] << ", " << (instr.imm32 & 63) << ");" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_IROL_R(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\t" << regR[instr.dst] << " = rotl(" << regR[instr.dst] << ", " << regR[instr.src] << " & 63);" << std::endl;
+		}
+		else if (instr.imm32 & 63) {
+			cxxCode << "\t\t" << regR[instr.dst] << " = rotl(" << regR[instr.dst] << ", " << (instr.imm32 & 63) << ");" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_ISWAP_R(Instruction& instr, int i) {
+		if (instr.src != instr.dst) {
+			cxxCode << "\t\tstd::swap(" << regR[instr.dst] << ", " << regR[instr.src] << ");" << std::endl;
+		}
+	}
+
+	void CxxGeneratorX86::h_FSWAP_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regFE[instr.dst] << " = _mm_shuffle_pd(" << regFE[instr.dst] << ", " << regFE[instr.dst] << ", 1);" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FADD_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regF[instr.dst % 4] << " = _mm_add_pd(" << regF[instr.dst % 4] << ", " << regA[instr.src % 4] << ");" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FADD_M(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regF[instr.dst % 4] << " = _mm_add_pd(" << regF[instr.dst % 4] << ", load_cvt_i32x2(" << genAddressReg(instr, instr.src, addressMask(instr)) << "));" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FSUB_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regF[instr.dst % 4] << " = _mm_sub_pd(" << regF[instr.dst % 4] << ", " << regA[instr.src % 4] << ");" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FSUB_M(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regF[instr.dst % 4] << " = _mm_sub_pd(" << regF[instr.dst % 4] << ", load_cvt_i32x2(" << genAddressReg(instr, instr.src, addressMask(instr)) << "));" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FSCAL_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regF[instr.dst % 4] << " = _mm_xor_pd(" << regF[instr.dst % 4] << ", signMask);" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FMUL_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regE[instr.dst % 4] << " = _mm_mul_pd(" << regE[instr.dst % 4] << ", " << regA[instr.src % 4] << ");" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FMUL_M(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regE[instr.dst % 4] << " = _mm_max_pd(_mm_mul_pd(" << regE[instr.dst % 4] << ", _mm_abs(load_cvt_i32x2(" << genAddressReg(instr, instr.src, addressMask(instr)) << "))), minDbl);" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FDIV_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regE[instr.dst % 4] << " = _mm_max_pd(_mm_div_pd(" << regE[instr.dst % 4] << ", " << regA[instr.src % 4] << "), minDbl);" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FDIV_M(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regE[instr.dst % 4] << " = _mm_max_pd(_mm_div_pd(" << regE[instr.dst % 4] << ", _mm_abs(load_cvt_i32x2(" << genAddressReg(instr, instr.src, addressMask(instr)) << "))), minDbl);" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FSQRT_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regE[instr.dst % 4] << " = _mm_sqrt_pd(" << regE[instr.dst % 4] << ");" << std::endl;
+	}
+
+	//the rounding control bits of MXCSR (13-14) come from bits imm32 and imm32+1 of the register
+	void CxxGeneratorX86::h_CFROUND(Instruction& instr, int i) {
+		int rotate = (13 - (instr.imm32 & 63)) & 63;
+		cxxCode << "\t\tRX_FPU_BARRIER();" << std::endl;
+		cxxCode << "\t\t_mm_setcsr(0x9FC0 | ((uint32_t)";
+		if (rotate != 0)
+			cxxCode << "rotl(" << regR[instr.src] << ", " << rotate << ")";
+		else
+			cxxCode << regR[instr.src];
+		cxxCode << " & 0x6000));" << std::endl;
+		cxxCode << "\t\tRX_FPU_BARRIER();" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_COND_R(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regR[instr.dst] << " += condition(" << (instr.mod & 7) << ", (uint32_t)" << regR[instr.src] << ", " << instr.imm32 << "U);" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_COND_M(Instruction& instr, int i) {
+		cxxCode << "\t\t" << regR[instr.dst] << " += condition(" << (instr.mod & 7) << ", load32(" << genAddressReg(instr, instr.src, addressMask(instr)) << "), " << instr.imm32 << "U);" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_ISTORE(Instruction& instr, int i) {
+		cxxCode << "\t\tstore64(" << genAddressReg(instr, instr.dst, addressMask(instr)) << ", " << regR[instr.src] << ");" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_FSTORE(Instruction& instr, int i) {
+		cxxCode << "\t\t_mm_store_pd((double*)(" << genAddressReg(instr, instr.dst, addressMask16(instr)) << "), " << regFE[instr.src] << ");" << std::endl;
+	}
+
+	void CxxGeneratorX86::h_NOP(Instruction& instr, int i) {
+	}
+
+#include "instructionWeights.hpp"
+#define INST_HANDLE(x) REPN(&CxxGeneratorX86::h_##x, WT(x))
+
+	CxxInstructionGenerator CxxGeneratorX86::engine[256] = {
+		//Integer
+		INST_HANDLE(IADD_R)
+		INST_HANDLE(IADD_M)
+		INST_HANDLE(IADD_RC)
+		INST_HANDLE(ISUB_R)
+		INST_HANDLE(ISUB_M)
+		INST_HANDLE(IMUL_9C)
+		INST_HANDLE(IMUL_R)
+		INST_HANDLE(IMUL_M)
+		INST_HANDLE(IMULH_R)
+		INST_HANDLE(IMULH_M)
+		INST_HANDLE(ISMULH_R)
+		INST_HANDLE(ISMULH_M)
+		INST_HANDLE(IDIV_C)
+		INST_HANDLE(ISDIV_C)
+		INST_HANDLE(INEG_R)
+		INST_HANDLE(IXOR_R)
+		INST_HANDLE(IXOR_M)
+		INST_HANDLE(IROR_R)
+		INST_HANDLE(IROL_R)
+		INST_HANDLE(ISWAP_R)
+
+		//Common floating point
+		INST_HANDLE(FSWAP_R)
+
+		//Floating point group F
+		INST_HANDLE(FADD_R)
+		INST_HANDLE(FADD_M)
+		INST_HANDLE(FSUB_R)
+		INST_HANDLE(FSUB_M)
+		INST_HANDLE(FSCAL_R)
+
+		//Floating point group E
+		INST_HANDLE(FMUL_R)
+		INST_HANDLE(FMUL_M)
+		INST_HANDLE(FDIV_R)
+		INST_HANDLE(FDIV_M)
+		INST_HANDLE(FSQRT_R)
+
+		//Control
+		INST_HANDLE(COND_R)
+		INST_HANDLE(COND_M)
+		INST_HANDLE(CFROUND)
+
+		INST_HANDLE(ISTORE)
+		INST_HANDLE(FSTORE)
+
+		INST_HANDLE(NOP)
+	};
+}
@@ -0,0 +1,615 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Differential fuzzer for the JIT code generation options. Random programs are
+	executed by a reference engine and by each engine under test from the same
+	state, and the register files, rounding modes and scratchpads are compared.
+	On a mismatch, the failing program is reduced to the instructions and the
+	number of iterations needed to reproduce it. Before fuzzing, each engine is
+	checked against spec vectors, see checkSpec.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Stopwatch.hpp"
+#include "common.hpp"
+#include "intrinPortable.h"
+#include "dataset.hpp"
+#include "hashAes1Rx4.hpp"
+#include "Program.hpp"
+#include "instructionOperands.hpp"
+#include "CompiledVirtualMachine.hpp"
+
+struct Options {
+	std::string engines;
+	bool help;
+	uint64_t seed;
+	uint64_t programs;
+	uint32_t iterations;
+	int chain;
+	int threads;
+	int specVectors;
+};
+
+struct Engine {
+	const char* name;
+	std::function<void(RandomX::CompiledVirtualMachine*)> configure;
+};
+
+static const Engine engines[] = {
+	{ "plain", [](RandomX::CompiledVirtualMachine* vm) { vm->setRenaming(false); vm->setPrefetching(false); vm->setInstructionSets(false, false); } },
+	{ "compiled", [](RandomX::CompiledVirtualMachine*) {} },
+	{ "scheduled", [](RandomX::CompiledVirtualMachine* vm) { vm->setScheduling(true); } },
+	{ "sse2", [](RandomX::CompiledVirtualMachine* vm) { vm->setInstructionSets(false, false); } },
+	{ "noRename", [](RandomX::CompiledVirtualMachine* vm) { vm->setRenaming(false); } },
+	{ "noPrefetch", [](RandomX::CompiledVirtualMachine* vm) { vm->setPrefetching(false); } },
+};
+
+//one engine with its own scratchpad
+struct Runner {
+	const Engine* engine;
+	RandomX::CompiledVirtualMachine* vm;
+	uint8_t* scratchpad;
+	uint32_t roundingMode; //left by the last program
+};
+
+static void createRunner(Runner& runner, RandomX::dataset_t dataset) {
+	runner.vm = new RandomX::CompiledVirtualMachine();
+	runner.engine->configure(runner.vm);
+	runner.vm->setDataset(dataset);
+	runner.scratchpad = (uint8_t*)_mm_malloc(RandomX::ScratchpadSize, 64);
+	if (runner.scratchpad == nullptr)
+		throw std::bad_alloc();
+	runner.vm->setScratchpad(runner.scratchpad);
+}
+
+static void destroyRunner(Runner& runner) {
+	delete runner.vm;
+	_mm_free(runner.scratchpad);
+}
+
+static void readOptions(int argc, char** argv, Options& options) {
+	options.help = false;
+	options.engines = "plain,compiled,scheduled";
+	options.seed = 0;
+	options.programs = 100000;
+	options.iterations = 32;
+	options.chain = 64;
+	options.threads = 1;
+	options.specVectors = 1024;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--engines" && hasValue)
+			options.engines = argv[++i];
+		else if (arg == "--help")
+			options.help = true;
+		else if (arg == "--seed" && hasValue)
+			options.seed = strtoull(argv[++i], nullptr, 0);
+		else if (arg == "--programs" && hasValue)
+			options.programs = strtoull(argv[++i], nullptr, 0);
+		else if (arg == "--iterations" && hasValue)
+			options.iterations = std::min(std::max(1, atoi(argv[++i])), (int)RandomX::InstructionCount);
+		else if (arg == "--chain" && hasValue)
+			options.chain = std::max(1, atoi(argv[++i]));
+		else if (arg == "--threads" && hasValue)
+			options.threads = std::max(1, atoi(argv[++i]));
+		else if (arg == "--specVectors" && hasValue)
+			options.specVectors = std::max(0, atoi(argv[++i]));
+		else
+			throw std::runtime_error("Unknown option " + arg);
+	}
+}
+
+static void printUsage(const char* executable) {
+	std::cout << "Usage: " << executable << " [OPTIONS]" << std::endl;
+	std::cout << "  --engines L     comma separated engines, the first one is the reference" << std::endl;
+	std::cout << "                  (default: plain,compiled,scheduled), available:" << std::endl;
+	std::cout << "                  ";
+	for (const Engine& engine : engines)
+		std::cout << engine.name << " ";
+	std::cout << std::endl;
+	std::cout << "  --programs N    number of random programs (default: 100000)" << std::endl;
+	std::cout << "  --iterations N  loop iterations per program (default: 32)" << std::endl;
+	std::cout << "  --chain N       programs that share a scratchpad, like the programs" << std::endl;
+	std::cout << "                  of a hash (default: 64)" << std::endl;
+	std::cout << "  --seed N        seed of the first chain, chain i uses seed N+i (default: 0)" << std::endl;
+	std::cout << "  --threads N     fuzzing threads, each with its own engines (default: 1)" << std::endl;
+	std::cout << "  --specVectors N  random vectors of IMUL_9C, IDIV_C and ISDIV_C checked against" << std::endl;
+	std::cout << "                  the reference before fuzzing (default: 1024)" << std::endl;
+}
+
+static const Engine& findEngine(const std::string& name) {
+	for (const Engine& engine : engines) {
+		if (name == engine.name)
+			return engine;
+	}
+	throw std::runtime_error("Unknown engine " + name);
+}
+
+//the scratchpad seed and the programs of a chain are generated from the chain seed
+static void initGenerator(uint64_t seed, uint64_t(&state)[8], uint64_t(&scratchpadSeed)[8]) {
+	memset(state, 0, sizeof(state));
+	state[0] = seed;
+	fillAes1Rx4<false>(state, sizeof(scratchpadSeed), scratchpadSeed);
+}
+
+static void run(Runner& runner, const RandomX::Program& program, uint32_t roundingMode, uint32_t iterations) {
+	*runner.vm->getProgramBuffer() = program;
+	runner.vm->setIterations(iterations);
+	runner.vm->initialize();
+	setRoundMode(roundingMode);
+	runner.vm->execute();
+	runner.roundingMode = getRoundMode();
+}
+
+static std::string hex(const void* p) {
+	std::ostringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << *(const uint64_t*)p;
+	return ss.str();
+}
+
+//describes the first difference between the states of two engines, empty if there is none
+static std::string compare(const Runner& ref, const Runner& test, bool scratchpad = true) {
+	const RandomX::RegisterFile& a = ref.vm->getRegisterFile();
+	const RandomX::RegisterFile& b = test.vm->getRegisterFile();
+	std::ostringstream ss;
+	for (int i = 0; i < RandomX::RegistersCount; ++i) {
+		if (a.r[i] != b.r[i]) {
+			ss << "r" << i << " = " << hex(&a.r[i]) << " vs " << hex(&b.r[i]);
+			return ss.str();
+		}
+	}
+	for (int i = 0; i < RandomX::RegistersCount / 2; ++i) {
+		if (memcmp(&a.f[i], &b.f[i], sizeof(a.f[i])) != 0) {
+			ss << "f" << i << " = " << hex(&a.f[i].hi) << hex(&a.f[i].lo) << " vs " << hex(&b.f[i].hi) << hex(&b.f[i].lo);
+			return ss.str();
+		}
+		if (memcmp(&a.e[i], &b.e[i], sizeof(a.e[i])) != 0) {
+			ss << "e" << i << " = " << hex(&a.e[i].hi) << hex(&a.e[i].lo) << " vs " << hex(&b.e[i].hi) << hex(&b.e[i].lo);
+			return ss.str();
+		}
+	}
+	if (ref.roundingMode != test.roundingMode) {
+		ss << "rounding mode " << ref.roundingMode << " vs " << test.roundingMode;
+		return ss.str();
+	}
+	if (scratchpad && memcmp(ref.scratchpad, test.scratchpad, RandomX::ScratchpadSize) != 0) {
+		size_t offset = std::mismatch(ref.scratchpad, ref.scratchpad + RandomX::ScratchpadSize, test.scratchpad).first - ref.scratchpad;
+		offset &= ~(size_t)7;
+		ss << "scratchpad[" << offset << "] = " << hex(ref.scratchpad + offset) << " vs " << hex(test.scratchpad + offset);
+		return ss.str();
+	}
+	return std::string();
+}
+
+//runs a program from a saved scratchpad on both engines
+static std::string diverges(Runner& ref, Runner& test, const uint8_t* start, const RandomX::Program& program, uint32_t roundingMode, uint32_t iterations) {
+	memcpy(ref.scratchpad, start, RandomX::ScratchpadSize);
+	memcpy(test.scratchpad, start, RandomX::ScratchpadSize);
+	run(ref, program, roundingMode, iterations);
+	run(test, program, roundingMode, iterations);
+	return compare(ref, test);
+}
+
+/*
+	The engines share most of their code generators, so they can't catch a bug
+	they all have. The integer instructions that aren't a single x86 instruction
+	are also checked against the table below and against a reference written
+	from doc/isa-ops.md, which shares no code with the JIT compiler.
+*/
+struct SpecVector {
+	int type;
+	uint64_t dst;
+	uint32_t imm32;
+	uint64_t result;
+};
+
+static const SpecVector specVectors[] = {
+	{ RandomX::InstructionType::IMUL_9C, 0x0000000000000001, 0x00000000, 0x0000000000000009 },
+	{ RandomX::InstructionType::IMUL_9C, 0x1111111111111111, 0x00000001, 0x999999999999999a },
+	{ RandomX::InstructionType::IMUL_9C, 0x0000000000000002, 0xffffffff, 0x0000000000000011 },
+	{ RandomX::InstructionType::IMUL_9C, 0x8000000000000000, 0x80000000, 0x7fffffff80000000 },
+	{ RandomX::InstructionType::IMUL_9C, 0xfedcba9876543210, 0x7fffffff, 0xf5c28f5ca8f5c28f },
+	{ RandomX::InstructionType::IDIV_C, 0x000000000000001a, 0x00004000, 0x000000000000001a },
+	{ RandomX::InstructionType::IDIV_C, 0x00000000000003e8, 0x00000001, 0x00000000000007d0 },
+	{ RandomX::InstructionType::IDIV_C, 0x000000000000007b, 0x00000000, 0x000000000000007b },
+	{ RandomX::InstructionType::IDIV_C, 0x0000000000000064, 0x00000007, 0x0000000000000072 },
+	{ RandomX::InstructionType::IDIV_C, 0xffffffffffffffff, 0x00000003, 0x5555555555555554 },
+	{ RandomX::InstructionType::IDIV_C, 0x8000000000000000, 0x80000000, 0x8000000100000000 },
+	{ RandomX::InstructionType::IDIV_C, 0xffffffffffffffff, 0xffffffff, 0x0000000100000000 },
+	{ RandomX::InstructionType::IDIV_C, 0x123456789abcdef0, 0x00000010, 0x13579be02468acdf },
+	{ RandomX::InstructionType::IDIV_C, 0x123456789abcdef0, 0x00012345, 0x12346678a06ce0f5 },
+	{ RandomX::InstructionType::ISDIV_C, 0xffffffffffffff9c, 0x00000007, 0xffffffffffffff8e },
+	{ RandomX::InstructionType::ISDIV_C, 0x0000000000000064, 0xfffffff8, 0x0000000000000058 },
+	{ RandomX::InstructionType::ISDIV_C, 0xffffffffffffff9c, 0x00000010, 0xffffffffffffff96 },
+	{ RandomX::InstructionType::ISDIV_C, 0x8000000000000000, 0xffffffff, 0x0000000000000000 },
+	{ RandomX::InstructionType::ISDIV_C, 0x0000000000000005, 0x00000000, 0x0000000000000005 },
+	{ RandomX::InstructionType::ISDIV_C, 0x7fffffffffffffff, 0x80000000, 0x7fffffff00000000 },
+	{ RandomX::InstructionType::ISDIV_C, 0x8000000000000000, 0x00000001, 0x0000000000000000 },
+	{ RandomX::InstructionType::ISDIV_C, 0xffffffffffffffff, 0x00000002, 0xffffffffffffffff },
+	{ RandomX::InstructionType::ISDIV_C, 0x123456789abcdef0, 0xfffedcbb, 0x12344678950cdceb },
+};
+
+static const char* instructionName(int type) {
+	RandomX::Instruction instr;
+	instr.opcode = RandomX::firstOpcode(type);
+	return instr.getName();
+}
+
+static uint64_t reference(int type, uint64_t dst, uint32_t imm32) {
+	int64_t simm = (int32_t)imm32;
+	switch (type) {
+	case RandomX::InstructionType::IMUL_9C:
+		return 9 * dst + (uint64_t)simm;
+	case RandomX::InstructionType::IDIV_C:
+		return imm32 == 0 ? dst : dst + dst / imm32;
+	case RandomX::InstructionType::ISDIV_C:
+		if (simm == 0)
+			return dst;
+		//signed overflow sets the register to zero
+		if (dst == 0x8000000000000000ULL && simm == -1)
+			return 0;
+		return dst + (uint64_t)((int64_t)dst / simm);
+	}
+	throw std::runtime_error("No reference for the instruction");
+}
+
+//executes up to 8 instructions, one per destination register, for one iteration
+static void runVectors(Runner& runner, const SpecVector* vectors, int count, uint64_t(&result)[8]) {
+	//every scratchpad line holds the initial register values, so the first load doesn't depend on the address
+	alignas(64) uint64_t line[8] = {};
+	RandomX::Program program;
+	for (int i = 0; i < RandomX::ProgramLength; ++i) {
+		RandomX::Instruction& instr = program(i);
+		instr.opcode = RandomX::firstOpcode(RandomX::InstructionType::IADD_R);
+		instr.dst = instr.src = instr.mod = 0;
+		instr.imm32 = 0;
+	}
+	for (int i = 0; i < count; ++i) {
+		RandomX::Instruction& instr = program(i);
+		instr.opcode = RandomX::firstOpcode(vectors[i].type);
+		instr.dst = instr.src = i;
+		instr.imm32 = vectors[i].imm32;
+		line[i] = vectors[i].dst;
+	}
+	for (uint32_t offset = 0; offset < RandomX::ScratchpadSize; offset += sizeof(line))
+		memcpy(runner.scratchpad + offset, line, sizeof(line));
+	//the dataset reads zeros, so the registers keep the program results
+	run(runner, program, 0, 1);
+	memcpy(result, runner.vm->getRegisterFile().r, sizeof(result));
+}
+
+//returns the number of vectors that don't match
+static uint64_t checkVectors(Runner& runner, const SpecVector* vectors, int count) {
+	uint64_t failed = 0;
+	for (int first = 0; first < count; first += 8) {
+		int batch = std::min(8, count - first);
+		uint64_t result[8];
+		runVectors(runner, vectors + first, batch, result);
+		for (int i = 0; i < batch; ++i) {
+			const SpecVector& v = vectors[first + i];
+			if (result[i] == v.result)
+				continue;
+			if (failed++ < 4) {
+				std::cout << "SPEC MISMATCH in " << runner.engine->name << ": " << instructionName(v.type) << " " << hex(&v.dst) << ", 0x" << std::hex << v.imm32 << std::dec;
+				std::cout << " = " << hex(&result[i]) << " instead of " << hex(&v.result) << std::endl;
+			}
+		}
+	}
+	return failed;
+}
+
+//checks the table and random vectors, with a quarter of the divisors a power of two and a quarter negative
+static bool checkSpec(Runner& runner, uint64_t seed, int randomCount) {
+	const int types[] = { RandomX::InstructionType::IMUL_9C, RandomX::InstructionType::IDIV_C, RandomX::InstructionType::ISDIV_C };
+	std::vector<uint64_t> random(2 * randomCount);
+	alignas(16) uint64_t state[8] = { seed };
+	bool passed = true;
+	std::ostringstream summary;
+	for (int type : types) {
+		std::vector<SpecVector> vectors;
+		for (const SpecVector& v : specVectors) {
+			if (v.type != type)
+				continue;
+			if (reference(v.type, v.dst, v.imm32) != v.result)
+				throw std::runtime_error("The spec vectors and the reference disagree");
+			vectors.push_back(v);
+		}
+		fillAes1Rx4<false>(state, random.size() * sizeof(uint64_t), random.data());
+		for (int i = 0; i < randomCount; ++i) {
+			SpecVector v;
+			v.type = type;
+			v.dst = random[2 * i];
+			v.imm32 = (uint32_t)random[2 * i + 1];
+			uint32_t shift = (random[2 * i + 1] >> 32) & 31;
+			switch (random[2 * i + 1] >> 62) {
+			case 1:
+				v.imm32 = 1U << shift;
+				break;
+			case 2:
+				v.imm32 = 0U - (1U << shift);
+				break;
+			}
+			v.result = reference(type, v.dst, v.imm32);
+			vectors.push_back(v);
+		}
+		uint64_t failed = checkVectors(runner, vectors.data(), vectors.size());
+		summary << (summary.tellp() > 0 ? ", " : ": ") << instructionName(type) << " " << failed << "/" << vectors.size();
+		passed = passed && failed == 0;
+	}
+	std::cout << "Spec vectors that differ in " << runner.engine->name << summary.str() << std::endl;
+	return passed;
+}
+
+/*
+	Reduces a failing program: first the number of iterations is bisected, then
+	instructions are replaced with a neutral one (IADD_R with src = dst and a
+	zero immediate) and immediates and mod bytes are cleared, as long as the
+	engines still differ. Bisection assumes that a difference doesn't disappear
+	in later iterations, which holds because every iteration writes all integer
+	and F registers to the scratchpad.
+*/
+static uint32_t minimize(Runner& ref, Runner& test, const uint8_t* start, RandomX::Program& program, uint32_t roundingMode, uint32_t iterations) {
+	uint32_t lo = 1, hi = iterations;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		if (diverges(ref, test, start, program, roundingMode, mid).empty())
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	iterations = hi;
+	RandomX::Instruction neutral;
+	neutral.opcode = RandomX::firstOpcode(RandomX::InstructionType::IADD_R);
+	neutral.dst = neutral.src = neutral.mod = 0;
+	neutral.imm32 = 0;
+	bool reduced = true;
+	while (reduced) {
+		reduced = false;
+		for (int i = 0; i < RandomX::ProgramLength; ++i) {
+			RandomX::Instruction& instr = program(i);
+			RandomX::Instruction original = instr;
+			if (memcmp(&instr, &neutral, sizeof(instr)) == 0)
+				continue;
+			instr = neutral;
+			if (!diverges(ref, test, start, program, roundingMode, iterations).empty()) {
+				reduced = true;
+				continue;
+			}
+			instr = original;
+			if (instr.imm32 != 0) {
+				instr.imm32 = 0;
+				if (diverges(ref, test, start, program, roundingMode, iterations).empty())
+					instr.imm32 = original.imm32;
+				else
+					reduced = true;
+			}
+			if (instr.mod != 0) {
+				instr.mod = 0;
+				if (diverges(ref, test, start, program, roundingMode, iterations).empty())
+					instr.mod = original.mod;
+				else
+					reduced = true;
+			}
+		}
+	}
+	for (int i = 0; i < RandomX::ProgramLength; ++i) {
+		if (memcmp(&program(i), &neutral, sizeof(neutral)) != 0)
+			std::cout << "  " << std::setw(3) << i << ": " << program(i);
+	}
+	return iterations;
+}
+
+//replays a chain with a full comparison after each program and minimizes the first program that fails
+static void report(const Options& options, Runner& ref, Runner& test, uint64_t chainSeed, const std::vector<RandomX::Program>& programs) {
+	uint8_t* start = (uint8_t*)_mm_malloc(RandomX::ScratchpadSize, 64);
+	if (start == nullptr)
+		throw std::bad_alloc();
+	alignas(16) uint64_t state[8];
+	alignas(16) uint64_t scratchpadSeed[8];
+	initGenerator(chainSeed, state, scratchpadSeed);
+	fillAes1Rx4<false>(scratchpadSeed, RandomX::ScratchpadSize, start);
+	uint32_t roundingMode = (uint32_t)state[0] & 3;
+	size_t failing = 0;
+	std::string difference;
+	for (; failing < programs.size(); ++failing) {
+		difference = diverges(ref, test, start, programs[failing], roundingMode, options.iterations);
+		if (!difference.empty())
+			break;
+		memcpy(start, ref.scratchpad, RandomX::ScratchpadSize);
+		roundingMode = ref.roundingMode;
+	}
+	std::cout << "MISMATCH between " << ref.engine->name << " and " << test.engine->name << " in chain seed " << chainSeed;
+	if (failing == programs.size()) {
+		std::cout << ", which doesn't reproduce when the chain is replayed" << std::endl;
+	}
+	else {
+		std::cout << ", program " << failing << ": " << difference << std::endl;
+		std::cout << "Reproduce with --engines " << ref.engine->name << "," << test.engine->name << " --seed " << chainSeed;
+		std::cout << " --programs " << failing + 1 << " --iterations " << options.iterations << std::endl;
+		std::cout << "Minimized program (other instructions are IADD_R r0, 0), rounding mode " << roundingMode << ":" << std::endl;
+		RandomX::Program program = programs[failing];
+		uint32_t iterations = minimize(ref, test, start, program, roundingMode, options.iterations);
+		std::cout << "The engines differ after iteration " << iterations << ": " << diverges(ref, test, start, program, roundingMode, iterations) << std::endl;
+	}
+	_mm_free(start);
+}
+
+//shared by the fuzzing threads, which take chains in order
+struct Progress {
+	std::atomic<uint64_t> nextChain;
+	std::atomic<uint64_t> checked;
+	std::atomic<bool> failed;
+	std::atomic<bool> error;
+	std::mutex output;
+	double lastReport;
+	Stopwatch sw;
+};
+
+static void fuzz(const Options& options, const std::vector<const Engine*>& selected, RandomX::dataset_t dataset, Progress& progress) {
+	std::vector<Runner> runners;
+	try {
+		for (const Engine* engine : selected) {
+			runners.push_back(Runner{ engine, nullptr, nullptr, 0 });
+			createRunner(runners.back(), dataset);
+		}
+		Runner& ref = runners[0];
+		uint64_t chains = (options.programs + options.chain - 1) / options.chain;
+		std::vector<RandomX::Program> programs;
+		uint64_t chain;
+		while (!progress.failed && (chain = progress.nextChain++) < chains) {
+			uint64_t chainSeed = options.seed + chain;
+			uint64_t count = std::min((uint64_t)options.chain, options.programs - chain * options.chain);
+			alignas(16) uint64_t state[8];
+			alignas(16) uint64_t scratchpadSeed[8];
+			initGenerator(chainSeed, state, scratchpadSeed);
+			fillAes1Rx4<false>(scratchpadSeed, RandomX::ScratchpadSize, ref.scratchpad);
+			for (size_t i = 1; i < runners.size(); ++i)
+				memcpy(runners[i].scratchpad, ref.scratchpad, RandomX::ScratchpadSize);
+			uint32_t roundingMode = (uint32_t)state[0] & 3;
+			programs.clear();
+			size_t failing = 0;
+			for (uint64_t k = 0; k < count && failing == 0; ++k) {
+				programs.emplace_back();
+				fillAes1Rx4<false>(state, sizeof(RandomX::Program), &programs.back());
+				for (Runner& runner : runners)
+					run(runner, programs.back(), roundingMode, options.iterations);
+				//comparing the scratchpads dominates the run time, so they are compared at the end of the chain
+				for (size_t i = 1; i < runners.size() && failing == 0; ++i) {
+					if (!compare(ref, runners[i], k + 1 == count).empty())
+						failing = i;
+				}
+				roundingMode = ref.roundingMode;
+			}
+			if (failing != 0) {
+				std::lock_guard<std::mutex> lock(progress.output);
+				if (!progress.failed.exchange(true))
+					report(options, ref, runners[failing], chainSeed, programs);
+				break;
+			}
+			progress.checked += count;
+			if (progress.sw.getElapsed() - progress.lastReport >= 10) {
+				std::lock_guard<std::mutex> lock(progress.output);
+				double elapsed = progress.sw.getElapsed();
+				if (elapsed - progress.lastReport >= 10) {
+					progress.lastReport = elapsed;
+					std::cout << progress.checked << " programs, " << (uint64_t)(progress.checked * 60 / elapsed) << " programs/min" << std::endl;
+				}
+			}
+		}
+	}
+	catch (std::exception& e) {
+		std::lock_guard<std::mutex> lock(progress.output);
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		progress.error = true;
+		progress.failed = true;
+	}
+	for (Runner& runner : runners)
+		destroyRunner(runner);
+	initFpu();
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	try {
+		readOptions(argc, argv, options);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (options.help) {
+		printUsage(argv[0]);
+		return 0;
+	}
+
+	std::vector<const Engine*> selected;
+	RandomX::dataset_t dataset;
+	try {
+		std::istringstream names(options.engines);
+		std::string name;
+		while (std::getline(names, name, ','))
+			selected.push_back(&findEngine(name));
+		if (selected.size() < 2)
+			throw std::runtime_error("At least two engines are needed");
+		//the dataset pages are not backed, so every dataset read returns zeros
+		PageSize pageSize;
+		RandomX::datasetAlloc(dataset, false, pageSize);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	bool specFailed = false;
+	for (const Engine* engine : selected) {
+		Runner runner{ engine, nullptr, nullptr, 0 };
+		try {
+			createRunner(runner, dataset);
+			if (!checkSpec(runner, options.seed, options.specVectors))
+				specFailed = true;
+		}
+		catch (std::exception& e) {
+			std::cerr << "ERROR: " << e.what() << std::endl;
+			destroyRunner(runner);
+			return 1;
+		}
+		destroyRunner(runner);
+	}
+	initFpu();
+	if (specFailed)
+		return 2;
+
+	std::cout << "Checking " << options.programs << " programs of " << options.iterations << " iterations";
+	std::cout << ", reference engine " << selected[0]->name << ", threads: " << options.threads << std::endl;
+
+	Progress progress;
+	progress.nextChain = 0;
+	progress.checked = 0;
+	progress.failed = false;
+	progress.error = false;
+	progress.lastReport = 0;
+	progress.sw.start();
+	std::vector<std::thread> threads;
+	for (int i = 1; i < options.threads; ++i)
+		threads.push_back(std::thread(&fuzz, std::cref(options), std::cref(selected), dataset, std::ref(progress)));
+	fuzz(options, selected, dataset, progress);
+	for (std::thread& thread : threads)
+		thread.join();
+	double elapsed = progress.sw.getElapsed();
+	std::cout << "Checked " << progress.checked << " programs with " << selected.size() << " engines in " << std::fixed << std::setprecision(2) << elapsed << " s (";
+	std::cout << (uint64_t)(progress.checked * 60 / elapsed) << " programs/min)" << std::endl;
+	_mm_free(dataset.dataset);
+	if (progress.error)
+		return 1;
+	return progress.failed ? 2 : 0;
+}
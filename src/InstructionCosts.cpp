@@ -0,0 +1,167 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include "InstructionCosts.hpp"
+#include "instructionOperands.hpp"
+
+namespace RandomX {
+
+	//estimated latencies in cycles, including address calculation and loads
+	static const uint8_t defaultLatency[] = {
+		1,  //IADD_R
+		6,  //IADD_M
+		1,  //IADD_RC
+		1,  //ISUB_R
+		6,  //ISUB_M
+		1,  //IMUL_9C
+		3,  //IMUL_R
+		8,  //IMUL_M
+		4,  //IMULH_R
+		9,  //IMULH_M
+		4,  //ISMULH_R
+		9,  //ISMULH_M
+		6,  //IDIV_C
+		8,  //ISDIV_C
+		1,  //INEG_R
+		1,  //IXOR_R
+		6,  //IXOR_M
+		2,  //IROR_R
+		2,  //IROL_R
+		2,  //ISWAP_R
+		1,  //FSWAP_R
+		4,  //FADD_R
+		14, //FADD_M
+		4,  //FSUB_R
+		14, //FSUB_M
+		1,  //FSCAL_R
+		4,  //FMUL_R
+		15, //FMUL_M
+		18, //FDIV_R
+		29, //FDIV_M
+		18, //FSQRT_R
+		2,  //COND_R
+		7,  //COND_M
+		8,  //CFROUND
+		1,  //ISTORE
+		1,  //FSTORE
+		1,  //NOP
+	};
+
+	//estimated reciprocal throughputs in cycles
+	static const double defaultThroughput[] = {
+		0.25, //IADD_R
+		0.5,  //IADD_M
+		0.25, //IADD_RC
+		0.25, //ISUB_R
+		0.5,  //ISUB_M
+		0.5,  //IMUL_9C
+		1,    //IMUL_R
+		1,    //IMUL_M
+		1,    //IMULH_R
+		1,    //IMULH_M
+		1,    //ISMULH_R
+		1,    //ISMULH_M
+		1.5,  //IDIV_C
+		2,    //ISDIV_C
+		0.25, //INEG_R
+		0.25, //IXOR_R
+		0.5,  //IXOR_M
+		0.5,  //IROR_R
+		0.5,  //IROL_R
+		0.5,  //ISWAP_R
+		1,    //FSWAP_R
+		0.5,  //FADD_R
+		1,    //FADD_M
+		0.5,  //FSUB_R
+		1,    //FSUB_M
+		0.33, //FSCAL_R
+		0.5,  //FMUL_R
+		1,    //FMUL_M
+		4,    //FDIV_R
+		4,    //FDIV_M
+		4.5,  //FSQRT_R
+		0.75, //COND_R
+		1,    //COND_M
+		3,    //CFROUND
+		1,    //ISTORE
+		1,    //FSTORE
+		0.25, //NOP
+	};
+
+	static_assert(sizeof(defaultLatency) == InstructionTypeCount, "Invalid latency table");
+	static_assert(sizeof(defaultThroughput) == InstructionTypeCount * sizeof(double), "Invalid throughput table");
+
+	InstructionCosts::InstructionCosts() {
+		for (int i = 0; i < InstructionTypeCount; ++i) {
+			latency[i] = defaultLatency[i];
+			throughput[i] = defaultThroughput[i];
+		}
+	}
+
+	const char* InstructionCosts::typeName(int type) {
+		int opcode = firstOpcode(type);
+		if (opcode < 0)
+			return "NOP";
+		Instruction instr;
+		instr.opcode = opcode;
+		return instr.getName();
+	}
+
+	void InstructionCosts::load(const std::string& path) {
+		std::ifstream file(path);
+		if (!file.is_open())
+			throw std::runtime_error("Cannot open instruction cost profile " + path);
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(file, line)) {
+			lineNumber++;
+			if (line.empty() || line[0] == '#')
+				continue;
+			std::istringstream fields(line);
+			std::string name;
+			double lat, thr;
+			if (!(fields >> name >> lat >> thr) || lat < 0 || thr < 0)
+				throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected 'instruction latency throughput'");
+			int type = 0;
+			while (type < InstructionTypeCount && name != typeName(type))
+				type++;
+			if (type == InstructionTypeCount)
+				throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": unknown instruction " + name);
+			latency[type] = lat;
+			throughput[type] = thr;
+		}
+		host = path;
+	}
+
+	void InstructionCosts::save(std::ostream& os) const {
+		os << "# RandomX instruction costs in core cycles" << std::endl;
+		if (!host.empty())
+			os << "# host: " << host << std::endl;
+		os << "# instruction latency throughput" << std::endl;
+		os << std::fixed << std::setprecision(2);
+		for (int type = 0; type < InstructionTypeCount; ++type) {
+			os << std::left << std::setw(9) << typeName(type) << std::right << " " << latency[type] << " " << throughput[type] << std::endl;
+		}
+		os.unsetf(std::ios::floatfield);
+	}
+}
@@ -0,0 +1,50 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include "Instruction.hpp"
+
+namespace RandomX {
+
+	constexpr int InstructionTypeCount = InstructionType::NOP + 1;
+
+	/*
+		Cost of each instruction type as generated by the JIT, in core cycles:
+		the latency of a dependent chain (including the address calculation and
+		load of the memory operand) and the reciprocal throughput of independent
+		instructions. The defaults are estimates for a recent x86-64 core; the
+		probe tool (make probe) measures a profile of the current host, which is
+		read with load().
+	*/
+	struct InstructionCosts {
+		InstructionCosts();
+		double latency[InstructionTypeCount];
+		double throughput[InstructionTypeCount];
+		std::string host; //description of the measured host, empty for the defaults
+
+		//reads a profile written by save(), types missing from the file keep their current costs
+		void load(const std::string& path);
+		void save(std::ostream&) const;
+		static const char* typeName(int type);
+	};
+
+}
@@ -0,0 +1,263 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Measures the cost of each RandomX instruction as the JIT compiler emits it
+	on this host. For every instruction type, a program made of that instruction
+	only is compiled with JitCompilerX86::generateBody, once as a single
+	dependent chain (latency) and once as independent chains (reciprocal
+	throughput). The results are converted to core cycles using the latency of
+	a register add, which is one cycle on every x86-64 core, so no performance
+	counters are needed. The profile is written in the format read by
+	InstructionCosts::load (main --costs).
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "intrinPortable.h"
+#include "Program.hpp"
+#include "JitCompilerX86.hpp"
+#include "InstructionCosts.hpp"
+#include "instructionOperands.hpp"
+#include "cpuFeatures.hpp"
+
+using namespace RandomX;
+
+constexpr uint32_t ProbeImm = 0x2C5A7F13; //odd and not a power of 2, so IDIV_C and IMUL_9C take their general paths
+
+struct ProbeOptions {
+	std::string output;
+	uint64_t iterations;
+	int reps;
+	bool noRename;
+	bool sse2;
+	bool help;
+};
+
+static void readOptions(int argc, char** argv, ProbeOptions& options) {
+	options.iterations = 4096;
+	options.reps = 7;
+	options.noRename = false;
+	options.sse2 = false;
+	options.help = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--output" && hasValue)
+			options.output = argv[++i];
+		else if (arg == "--iterations" && hasValue)
+			options.iterations = std::max(1, atoi(argv[++i]));
+		else if (arg == "--reps" && hasValue)
+			options.reps = std::max(1, atoi(argv[++i]));
+		else if (arg == "--noRename")
+			options.noRename = true;
+		else if (arg == "--sse2")
+			options.sse2 = true;
+		else if (arg == "--help")
+			options.help = true;
+		else
+			throw std::runtime_error("Unknown option " + arg);
+	}
+}
+
+static void printUsage(const char* executable) {
+	std::cout << "Usage: " << executable << " [OPTIONS]" << std::endl;
+	std::cout << "  --output F      write the instruction cost profile to F" << std::endl;
+	std::cout << "  --iterations N  loop iterations of each probe program (default: 4096)" << std::endl;
+	std::cout << "  --reps N        runs of each probe, the fastest is used (default: 7)" << std::endl;
+	std::cout << "  --noRename      probe the code generated without register renaming" << std::endl;
+	std::cout << "  --sse2          probe the SSE2 encodings instead of AVX and BMI2" << std::endl;
+}
+
+//integer instructions with a memory operand, their address register can carry the chain
+static bool isIntegerLoad(int type) {
+	uint16_t op = instructionOperands[type];
+	return (op & ReadMemory) && (op & WriteDst);
+}
+
+static bool isFloat(int type) {
+	return (instructionOperands[type] & (FloatDst | MulDst | XmmDst)) != 0;
+}
+
+/*
+	Latency: every instruction depends on the previous one through dst. Integer
+	loads alternate dst and src, so the chain also goes through the address
+	calculation and the load.
+	Throughput: integer instructions write r0-r5 and read r6-r7, floating point
+	instructions use every register of their group, so the chains are independent.
+	With four F or E registers, a floating point throughput can't be lower than
+	a quarter of its latency, which is also the bound in a real program.
+*/
+static void makeProgram(Program& prog, int type, bool chain) {
+	uint8_t opcode = firstOpcode(type);
+	for (unsigned i = 0; i < ProgramLength; ++i) {
+		Instruction& instr = prog(i);
+		instr.opcode = opcode;
+		instr.mod = 1; //L1 scratchpad operands
+		instr.imm32 = ProbeImm;
+		if (chain) {
+			bool swap = isIntegerLoad(type) && (i & 1);
+			instr.dst = swap ? 1 : 0;
+			instr.src = swap ? 0 : 1;
+		}
+		else {
+			instr.dst = isFloat(type) ? i % 8 : i % 6;
+			instr.src = 6 + i % 2;
+		}
+	}
+}
+
+class Probe {
+public:
+	Probe(const ProbeOptions& options) : options(options), scratchpad((uint8_t*)_mm_malloc(ScratchpadSize, 64)) {
+		if (scratchpad == nullptr)
+			throw std::bad_alloc();
+		//int32 operands of 1 keep the floating point loads at 1.0
+		for (uint32_t i = 0; i < ScratchpadSize / sizeof(int32_t); ++i)
+			((int32_t*)scratchpad)[i] = 1;
+		memset(&mem, 0, sizeof(mem));
+		compiler.setScheduling(false);
+		compiler.setRenaming(!options.noRename);
+		compiler.setPrefetching(false);
+		if (options.sse2)
+			compiler.setInstructionSets(false, false);
+	}
+	~Probe() {
+		_mm_free(scratchpad);
+	}
+	//nanoseconds per instruction of the fastest run
+	double measure(Program& prog) {
+		compiler.generateBody(prog);
+		ProgramFunc func = compiler.getProgramFunc();
+		unsigned csr = _mm_getcsr();
+		double best = 1e30;
+		for (int r = 0; r < options.reps; ++r) {
+			resetRegisters();
+			auto start = std::chrono::steady_clock::now();
+			func(reg, mem, scratchpad, options.iterations);
+			auto end = std::chrono::steady_clock::now();
+			double ns = std::chrono::duration<double, std::nano>(end - start).count();
+			best = std::min(best, ns / (options.iterations * ProgramLength));
+		}
+		_mm_setcsr(csr);
+		return best;
+	}
+	const char* getInstructionSets() {
+		return compiler.usesAvx() ? (compiler.usesBmi2() ? "AVX and BMI2" : "AVX") : (compiler.usesBmi2() ? "SSE2 and BMI2" : "SSE2");
+	}
+private:
+	const ProbeOptions& options;
+	JitCompilerX86 compiler;
+	alignas(64) RegisterFile reg;
+	MemoryRegisters mem;
+	uint8_t* scratchpad;
+
+	//values that stay finite and normal over millions of dependent operations
+	void resetRegisters() {
+		for (int i = 0; i < RegistersCount; ++i)
+			reg.r[i] = 0x9E3779B97F4A7C15ULL * (i + 1) | 1;
+		for (int i = 0; i < RegistersCount / 2; ++i) {
+			reg.f[i] = { 1.5, 1.25 };
+			reg.e[i] = { 1.0000001, 0.9999999 };
+			reg.a[i] = { 1.0000001, 0.9999999 };
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	ProbeOptions options;
+	try {
+		readOptions(argc, argv, options);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (options.help) {
+		printUsage(argv[0]);
+		return 0;
+	}
+	try {
+		Probe probe(options);
+		Program prog;
+		memset(&prog, 0, sizeof(prog));
+		double latencyNs[InstructionTypeCount], throughputNs[InstructionTypeCount];
+		bool measured[InstructionTypeCount];
+		for (int type = 0; type < InstructionTypeCount; ++type) {
+			measured[type] = firstOpcode(type) >= 0;
+			if (!measured[type])
+				continue;
+			makeProgram(prog, type, true);
+			latencyNs[type] = probe.measure(prog);
+			makeProgram(prog, type, false);
+			throughputNs[type] = probe.measure(prog);
+		}
+		double cycleNs = latencyNs[InstructionType::IADD_R];
+		//floating point loads can't be chained through their address, add the load-to-use latency of IADD_M
+		double loadUse = latencyNs[InstructionType::IADD_M] - cycleNs;
+
+		InstructionCosts costs;
+		std::cout << "Instruction costs in cycles (" << probe.getInstructionSets() << (options.noRename ? "" : ", register renaming");
+		std::cout << ", " << std::setprecision(3) << 1 / cycleNs << " GHz):" << std::endl;
+		std::cout << "instruction  latency  throughput" << std::endl;
+		for (int type = 0; type < InstructionTypeCount; ++type) {
+			if (!measured[type])
+				continue;
+			double latency = latencyNs[type];
+			if (isFloat(type) && (instructionOperands[type] & ReadMemory))
+				latency += loadUse;
+			costs.latency[type] = latency / cycleNs;
+			costs.throughput[type] = throughputNs[type] / cycleNs;
+			std::cout << std::left << std::setw(11) << InstructionCosts::typeName(type) << std::right << std::fixed << std::setprecision(2);
+			std::cout << std::setw(9) << costs.latency[type] << std::setw(12) << costs.throughput[type] << std::endl;
+			std::cout.unsetf(std::ios::floatfield);
+		}
+
+		char vendor[13];
+		unsigned family, model;
+		std::ostringstream host;
+		if (cpuSignature(vendor, family, model))
+			host << vendor << " family " << family << " model " << model << ", ";
+		host << std::setprecision(3) << 1 / cycleNs << " GHz, " << probe.getInstructionSets() << (options.noRename ? "" : ", register renaming");
+		costs.host = host.str();
+		if (!options.output.empty()) {
+			std::ofstream file(options.output);
+			if (!file.is_open())
+				throw std::runtime_error("Cannot write " + options.output);
+			costs.save(file);
+			std::cout << "Profile written to " << options.output << std::endl;
+		}
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
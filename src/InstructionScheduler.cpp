@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <functional>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include "InstructionScheduler.hpp"
+#include "InstructionCosts.hpp"
+#include "instructionOperands.hpp"
+#include "Program.hpp"
+
+namespace RandomX {
+
+	//number of instructions picked per simulated cycle
+	constexpr int IssueWidth = 4;
+
+	static int lowestBit(uint32_t x) {
+#if defined(__GNUC__)
+		return __builtin_ctz(x);
+#elif defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, x);
+		return index;
+#else
+		int bit = 0;
+		while (!(x & 1)) {
+			x >>= 1;
+			++bit;
+		}
+		return bit;
+#endif
+	}
+
+	InstructionScheduler::InstructionScheduler() {
+		setCosts(InstructionCosts());
+	}
+
+	void InstructionScheduler::setCosts(const InstructionCosts& costs) {
+		for (int type = 0; type < InstructionTypeCount; ++type) {
+			double cycles = costs.latency[type] + 0.5;
+			typeLatency[type] = cycles < 255 ? (uint8_t)cycles : 255;
+		}
+	}
+
+	uint32_t InstructionScheduler::priorityKey(int node) {
+		return (height[node] << 8) | (0xff - node);
+	}
+
+	void InstructionScheduler::addEdge(int from, int to) {
+		edgeTarget[edgeCount] = to;
+		nextEdge[edgeCount] = firstEdge[from];
+		firstEdge[from] = edgeCount;
+		edgeCount++;
+		predCount[to]++;
+	}
+
+	const uint8_t* InstructionScheduler::schedule(Program& prog) {
+		int lastWriter[ResourceCount];
+		uint8_t readers[ResourceCount][ProgramLength];
+		int readerCount[ResourceCount];
+		for (int r = 0; r < ResourceCount; ++r) {
+			lastWriter[r] = -1;
+			readerCount[r] = 0;
+		}
+		edgeCount = 0;
+		//dependency graph: read after write, write after write and write after read
+		for (int i = 0; i < ProgramLength; ++i) {
+			Instruction& instr = prog(i);
+			uint32_t reads, writes;
+			getResources(instr, reads, writes);
+			latency[i] = typeLatency[instructionType[instr.opcode]];
+			firstEdge[i] = -1;
+			predCount[i] = 0;
+			earliest[i] = 0;
+			for (uint32_t used = reads | writes; used != 0; used &= used - 1) {
+				int r = lowestBit(used);
+				uint32_t mask = 1U << r;
+				if (lastWriter[r] >= 0)
+					addEdge(lastWriter[r], i);
+				if (writes & mask) {
+					for (int j = 0; j < readerCount[r]; ++j) {
+						addEdge(readers[r][j], i);
+					}
+					readerCount[r] = 0;
+					lastWriter[r] = i;
+				}
+				else if (reads & mask) {
+					readers[r][readerCount[r]++] = i;
+				}
+			}
+		}
+		//priority: length of the longest latency path to the end of the program
+		for (int i = ProgramLength - 1; i >= 0; --i) {
+			int maxHeight = 0;
+			for (int e = firstEdge[i]; e >= 0; e = nextEdge[e]) {
+				if (height[edgeTarget[e]] > maxHeight)
+					maxHeight = height[edgeTarget[e]];
+			}
+			height[i] = latency[i] + maxHeight;
+		}
+		//instructions whose operands are ready, highest priority on top, program order breaks ties
+		uint32_t available[ProgramLength];
+		int availableCount = 0;
+		//instructions waiting for the results of their predecessors, earliest cycle on top
+		uint32_t pending[ProgramLength];
+		int pendingCount = 0;
+		for (int i = 0; i < ProgramLength; ++i) {
+			if (predCount[i] == 0)
+				available[availableCount++] = priorityKey(i);
+		}
+		std::make_heap(available, available + availableCount);
+		int cycle = 0, count = 0;
+		while (count < ProgramLength) {
+			while (pendingCount > 0 && (int)(pending[0] >> 8) <= cycle) {
+				available[availableCount++] = priorityKey(pending[0] & 0xff);
+				std::push_heap(available, available + availableCount);
+				std::pop_heap(pending, pending + pendingCount--, std::greater<uint32_t>());
+			}
+			if (availableCount == 0) {
+				//skip the cycles in which nothing can be issued
+				cycle = pending[0] >> 8;
+				continue;
+			}
+			for (int issued = 0; issued < IssueWidth && availableCount > 0; ++issued) {
+				int node = 0xff - (available[0] & 0xff);
+				std::pop_heap(available, available + availableCount--);
+				order[count++] = node;
+				for (int e = firstEdge[node]; e >= 0; e = nextEdge[e]) {
+					int succ = edgeTarget[e];
+					if (earliest[succ] < cycle + latency[node])
+						earliest[succ] = cycle + latency[node];
+					if (--predCount[succ] == 0) {
+						pending[pendingCount++] = (earliest[succ] << 8) | succ;
+						std::push_heap(pending, pending + pendingCount, std::greater<uint32_t>());
+					}
+				}
+			}
+			cycle++;
+		}
+		return order;
+	}
+}
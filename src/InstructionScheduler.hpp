@@ -0,0 +1,61 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include "common.hpp"
+#include "InstructionCosts.hpp"
+
+namespace RandomX {
+
+	class Program;
+
+	/*
+		List scheduler for the program body. Builds the dependency graph of the
+		program (integer registers, F/E registers, the rounding mode set by CFROUND
+		and the scratchpad) and emits long latency chains first, so that a small
+		out-of-order window sees more independent instructions. Any order returned
+		gives exactly the same results as the program order.
+	*/
+	class InstructionScheduler {
+	public:
+		InstructionScheduler();
+		//replaces the estimated latencies, e.g. with a profile measured on the host
+		void setCosts(const InstructionCosts&);
+		//returns the emission order of the program instructions
+		//src and dst of all instructions must already be reduced modulo RegistersCount
+		const uint8_t* schedule(Program&);
+	private:
+		//at most 5 resources per instruction plus one write after read edge per read
+		static constexpr int MaxEdges = 16 * ProgramLength;
+		void addEdge(int from, int to);
+		uint32_t priorityKey(int node);
+		uint8_t typeLatency[InstructionTypeCount];
+		uint8_t order[ProgramLength];
+		uint8_t latency[ProgramLength];
+		uint16_t height[ProgramLength];
+		uint16_t earliest[ProgramLength];
+		uint16_t predCount[ProgramLength];
+		int16_t firstEdge[ProgramLength];
+		int16_t nextEdge[MaxEdges];
+		uint8_t edgeTarget[MaxEdges];
+		int edgeCount;
+	};
+}
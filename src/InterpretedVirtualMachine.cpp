@@ -22,6 +22,7 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 #include "dataset.hpp"
 #include "Cache.hpp"
 #include "LightClientAsyncWorker.hpp"
+#include "MemoryTrace.hpp"
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
@@ -83,8 +84,33 @@ namespace RandomX {
 	void InterpretedVirtualMachine::executeBytecode<ProgramLength>(int_reg_t(&r)[8], __m128d (&f)[4], __m128d (&e)[4], __m128d (&a)[4]) {
 	}
 
+	//called before the instruction executes, so that the address registers are not yet modified
+	void InterpretedVirtualMachine::traceInstruction(const InstructionByteCode& ibc) {
+		switch (ibc.type)
+		{
+			case InstructionType::IADD_M:
+			case InstructionType::ISUB_M:
+			case InstructionType::IMUL_M:
+			case InstructionType::IMULH_M:
+			case InstructionType::ISMULH_M:
+			case InstructionType::IXOR_M:
+			case InstructionType::FADD_M:
+			case InstructionType::FSUB_M:
+			case InstructionType::FDIV_M:
+			case InstructionType::COND_M:
+				memoryTrace->scratchpadRead(*ibc.isrc & ibc.memMask, ibc.memMask);
+				break;
+
+			case InstructionType::ISTORE:
+				memoryTrace->scratchpadWrite(*ibc.idst & ibc.memMask, ibc.memMask);
+				break;
+		}
+	}
+
 	FORCE_INLINE void InterpretedVirtualMachine::executeBytecode(int i, int_reg_t(&r)[8], __m128d (&f)[4], __m128d (&e)[4], __m128d (&a)[4]) {
 		auto& ibc = byteCode[i];
+		if (memoryTrace != nullptr)
+			traceInstruction(ibc);
 		switch (ibc.type)
 		{
 			case InstructionType::IADD_R: {
@@ -260,6 +286,9 @@ namespace RandomX {
 
 		precompileProgram(r, f, e, a);
 
+		if (memoryTrace != nullptr)
+			memoryTrace->record(AccessProgramStart, 0);
+
 		uint32_t spAddr0 = mem.mx;
 		uint32_t spAddr1 = mem.ma;
 
@@ -267,6 +296,8 @@ namespace RandomX {
 			//std::cout << "Iteration " << iter << std::endl;
 			spAddr0 ^= r[readReg0];
 			spAddr0 &= ScratchpadL3Mask64;
+			if (memoryTrace != nullptr)
+				memoryTrace->record(AccessLineRead, spAddr0);
 			
 			r[0] ^= load64(scratchpad + spAddr0 + 0);
 			r[1] ^= load64(scratchpad + spAddr0 + 8);
@@ -279,6 +310,8 @@ namespace RandomX {
 
 			spAddr1 ^= r[readReg1];
 			spAddr1 &= ScratchpadL3Mask64;
+			if (memoryTrace != nullptr)
+				memoryTrace->record(AccessLineRead, spAddr1);
 
 			f[0] = load_cvt_i32x2(scratchpad + spAddr1 + 0);
 			f[1] = load_cvt_i32x2(scratchpad + spAddr1 + 8);
@@ -291,6 +324,8 @@ namespace RandomX {
 
 			executeBytecode<0>(r, f, e, a);
 
+			if (memoryTrace != nullptr)
+				memoryTrace->record(AccessDataset, mem.ma / CacheLineSize);
 			if (asyncWorker) {
 				ILightClientAsyncWorker* aw = mem.ds.asyncWorker;
 				const uint64_t* datasetLine = aw->getBlock(mem.ma);
@@ -312,6 +347,10 @@ namespace RandomX {
 				std::swap(mem.mx, mem.ma);
 			}
 
+			if (memoryTrace != nullptr) {
+				memoryTrace->record(AccessLineWrite, spAddr1);
+				memoryTrace->record(AccessLineWrite, spAddr0);
+			}
 			store64(scratchpad + spAddr1 + 0, r[0]);
 			store64(scratchpad + spAddr1 + 8, r[1]);
 			store64(scratchpad + spAddr1 + 16, r[2]);
@@ -620,7 +659,7 @@ namespace RandomX {
 				CASE_REP(FSWAP_R) {
 					auto dst = instr.dst % RegistersCount;
 					ibc.type = InstructionType::FSWAP_R;
-					ibc.fdst = &f[dst];
+					ibc.fdst = dst < 4 ? &f[dst] : &e[dst - 4];
 				} break;
 
 				CASE_REP(FADD_R) {
@@ -726,6 +765,7 @@ namespace RandomX {
 					ibc.type = InstructionType::ISTORE;
 					ibc.idst = &r[dst];
 					ibc.isrc = &r[src];
+					ibc.memMask = ((instr.mod % 4) ? ScratchpadL1Mask : ScratchpadL2Mask);
 				} break;
 
 				CASE_REP(FSTORE) {
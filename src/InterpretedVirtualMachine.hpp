@@ -35,6 +35,7 @@ namespace RandomX {
 
 	struct InstructionByteCode;
 	class InterpretedVirtualMachine;
+	class MemoryTrace;
 
 	typedef void(InterpretedVirtualMachine::*InstructionHandler)(Instruction&);
 
@@ -61,16 +62,21 @@ namespace RandomX {
 
 	class InterpretedVirtualMachine : public VirtualMachine {
 	public:
-		InterpretedVirtualMachine(bool soft, bool async) : softAes(soft), asyncWorker(async) {}
+		InterpretedVirtualMachine(bool soft, bool async) : softAes(soft), asyncWorker(async), memoryTrace(nullptr) {}
 		~InterpretedVirtualMachine();
 		void setDataset(dataset_t ds) override;
 		void initialize() override;
 		void execute() override;
+		//records the scratchpad and dataset accesses of execute() if not null
+		void setMemoryTrace(MemoryTrace* trace) {
+			memoryTrace = trace;
+		}
 	private:
 		static InstructionHandler engine[256];
 		DatasetReadFunc readDataset;
 		bool softAes, asyncWorker;
 		InstructionByteCode byteCode[ProgramLength];
+		MemoryTrace* memoryTrace;
 		
 #ifdef STATS
 		int count_ADD_64 = 0;
@@ -126,5 +132,6 @@ namespace RandomX {
 		template<int N>
 		void executeBytecode(int_reg_t(&r)[8], __m128d (&f)[4], __m128d (&e)[4], __m128d (&a)[4]);
 		void executeBytecode(int i, int_reg_t(&r)[8], __m128d (&f)[4], __m128d (&e)[4], __m128d (&a)[4]);
+		void traceInstruction(const InstructionByteCode& ibc);
 	};
 }
\ No newline at end of file
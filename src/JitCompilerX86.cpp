@@ -19,25 +19,41 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
 #include "JitCompilerX86.hpp"
+#include "instructionOperands.hpp"
 #include "Program.hpp"
 #include "divideByConstantCodegen.h"
 #include "virtualMemory.hpp"
+#include "CodeRegion.hpp"
+#include "cpuFeatures.hpp"
 
 namespace RandomX {
 
 #if !defined(_M_X64) && !defined(__x86_64__)
-	JitCompilerX86::JitCompilerX86() {
+	JitCompilerX86::JitCompilerX86(CodeRegion* codeRegion, bool dualMapped) {
 		throw std::runtime_error("JIT compiler only supports x86-64 CPUs");
 	}
 
+	JitCompilerX86::~JitCompilerX86() {
+
+	}
+
 	void JitCompilerX86::generateProgram(Program& p) {
 
 	}
 
+	void JitCompilerX86::generateBody(Program& p) {
+
+	}
+
 	size_t JitCompilerX86::getCodeSize() {
 		return 0;
 	}
+
+	void JitCompilerX86::setPerfLog(PerfJitLog* log) {
+
+	}
 #else
 
 	/*
@@ -124,7 +140,6 @@ namespace RandomX {
 	static const uint8_t RAX_ADD_SBB_1[] = { 0x48, 0x83, 0xC0, 0x01, 0x48, 0x83, 0xD8, 0x00 };
 	static const uint8_t MUL_RCX[] = { 0x48, 0xf7, 0xe1 };
 	static const uint8_t REX_SHR_RDX[] = { 0x48, 0xc1, 0xea };
-	static const uint8_t REX_SH[] = { 0x49, 0xc1 };
 	static const uint8_t MOV_RCX_RAX_SAR_RCX_63[] = { 0x48, 0x89, 0xc1, 0x48, 0xc1, 0xf9, 0x3f };
 	static const uint8_t AND_ECX_I[] = { 0x81, 0xe1 };
 	static const uint8_t ADD_RAX_RCX[] = { 0x48, 0x01, 0xC8 };
@@ -158,6 +173,7 @@ namespace RandomX {
 	static const uint8_t REX_CMP_R32I[] = { 0x41, 0x81 };
 	static const uint8_t REX_CMP_M32I[] = { 0x81, 0x3c, 0x06 };
 	static const uint8_t MOVAPD[] = { 0x66, 0x0f, 0x29 };
+	static const uint8_t MOVAPD_RM[] = { 0x66, 0x0f, 0x28 };
 	static const uint8_t REX_MOV_MR[] = { 0x4c, 0x89 };
 	static const uint8_t REX_XOR_EAX[] = { 0x41, 0x33 };
 	static const uint8_t SUB_EBX[] = { 0x83, 0xEB, 0x01 };
@@ -169,16 +185,175 @@ namespace RandomX {
 	static const uint8_t REX_PADD[] = { 0x66, 0x44, 0x0f };
 	static const uint8_t PADD_OPCODES[] = { 0xfc, 0xfd, 0xfe, 0xd4 };
 
+	//temporaries used for scratchpad addresses
+	constexpr int Rax = 0;
+	constexpr int Rcx = 1;
+
+	//temporaries overwritten by the code of each instruction type other than with an address
+	static const uint8_t temporaryRegisters[] = {
+		0,                           //IADD_R
+		0,                           //IADD_M
+		0,                           //IADD_RC
+		0,                           //ISUB_R
+		0,                           //ISUB_M
+		0,                           //IMUL_9C
+		0,                           //IMUL_R
+		0,                           //IMUL_M
+		1 << Rax,                    //IMULH_R
+		1 << Rax,                    //IMULH_M
+		1 << Rax,                    //ISMULH_R
+		1 << Rax,                    //ISMULH_M
+		(1 << Rax) | (1 << Rcx),     //IDIV_C
+		(1 << Rax) | (1 << Rcx),     //ISDIV_C
+		0,                           //INEG_R
+		0,                           //IXOR_R
+		0,                           //IXOR_M
+		1 << Rcx,                    //IROR_R
+		1 << Rcx,                    //IROL_R
+		0,                           //ISWAP_R
+		0,                           //FSWAP_R
+		0,                           //FADD_R
+		0,                           //FADD_M
+		0,                           //FSUB_R
+		0,                           //FSUB_M
+		0,                           //FSCAL_R
+		0,                           //FMUL_R
+		0,                           //FMUL_M
+		0,                           //FDIV_R
+		0,                           //FDIV_M
+		0,                           //FSQRT_R
+		1 << Rcx,                    //COND_R
+		1 << Rcx,                    //COND_M
+		1 << Rax,                    //CFROUND
+		0,                           //ISTORE
+		0,                           //FSTORE
+		0,                           //NOP
+	};
+
+	static_assert(sizeof(temporaryRegisters) == InstructionType::NOP + 1, "Invalid temporary register table");
+
 	size_t JitCompilerX86::getCodeSize() {
 		return codePos - prologueSize;
 	}
 
-	JitCompilerX86::JitCompilerX86() {
-		code = (uint8_t*)allocExecutableMemory(CodeSize);
+	/*
+		The code buffer is taken from 'codeRegion' if provided and not full.
+		Otherwise a writable and executable buffer is allocated. When the OS refuses
+		that (or dualMapped is requested), the code is written through a RW view
+		and executed from a separate RX view of the same memory.
+	*/
+	JitCompilerX86::JitCompilerX86(CodeRegion* codeRegion, bool dualMapped) : dualMapped(false), codeRegion(nullptr), scheduling(false), renaming(true), prefetching(true), avx(cpuHasAvx()), bmi2(cpuHasBmi2()), layout(&detectCodeLayout()), perfLog(nullptr) {
+		CodeBuffer buffer;
+		if (codeRegion != nullptr && codeRegion->acquire(buffer)) {
+			this->codeRegion = codeRegion;
+			code = buffer.writable;
+			exec = buffer.executable;
+			this->dualMapped = codeRegion->isDualMapped();
+		}
+		else {
+			code = dualMapped ? nullptr : (uint8_t*)tryAllocExecutableMemory(CodeSize);
+			if (code != nullptr) {
+				exec = code;
+			}
+			else {
+				void *writable, *executable;
+				PageSize pageSize;
+				allocDualMappedMemory(CodeSize, writable, executable, false, pageSize);
+				code = (uint8_t*)writable;
+				exec = (uint8_t*)executable;
+				this->dualMapped = true;
+			}
+		}
 		memcpy(code, codePrologue, prologueSize);
 		memcpy(code + CodeSize - epilogueSize, codeEpilogue, epilogueSize);
 	}
 
+	JitCompilerX86::~JitCompilerX86() {
+		if (codeRegion != nullptr) {
+			codeRegion->release({ code, exec });
+		}
+		else if (dualMapped) {
+			freeDualMappedMemory(code, exec, CodeSize);
+		}
+		else {
+			freeExecutableMemory(code, CodeSize);
+		}
+	}
+
+	/*
+		The prologue and the epilogue never change, so they are logged once per
+		code buffer. The loop load has a fixed position too, but the other regions
+		move with the size of the program body: the perf map can only name the
+		whole variable part, while the jitdump gets its regions for every program.
+	*/
+	void JitCompilerX86::setPerfLog(PerfJitLog* log) {
+		perfLog = log;
+		if (log == nullptr)
+			return;
+		const int32_t bodyOffset = prologueSize + 2 * (sizeof(REX_XOR_RAX_R64) + 1) + loopLoadSize;
+		log->addCode(code, exec, 0, prologueSize, "prologue");
+		if (!log->isJitDump()) {
+			log->addCode(code, exec, prologueSize, bodyOffset - prologueSize, "loop_load");
+			log->addCode(code, exec, bodyOffset, epilogueOffset - bodyOffset, "program");
+		}
+		log->addCode(code, exec, epilogueOffset, epilogueSize, "epilogue");
+		markers.reserve(ProgramLength + 2);
+	}
+
+	static const uint8_t NOP1[] = { 0x90 };
+	static const uint8_t NOP2[] = { 0x66, 0x90 };
+	static const uint8_t NOP3[] = { 0x0f, 0x1f, 0x00 };
+	static const uint8_t NOP4[] = { 0x0f, 0x1f, 0x40, 0x00 };
+	static const uint8_t NOP5[] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+	static const uint8_t NOP6[] = { 0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+	static const uint8_t NOP7[] = { 0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00 };
+	static const uint8_t NOP8[] = { 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	static const uint8_t NOP9[] = { 0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	static const uint8_t* const NOPX[] = { NOP1, NOP2, NOP3, NOP4, NOP5, NOP6, NOP7, NOP8, NOP9 };
+
+	void JitCompilerX86::genNops(int count) {
+		while (count > 0) {
+			int size = count < 9 ? count : 9;
+			memcpy(code + codePos, NOPX[size - 1], size);
+			codePos += size;
+			count -= size;
+		}
+	}
+
+	/*
+		Pads the code with NOPs if a branch (or a fused pair) of the given size
+		emitted at the current position would cross the branch boundary of the
+		layout profile. The code buffer is page aligned, so codePos has the same
+		alignment as the executable address.
+	*/
+	void JitCompilerX86::alignBranch(int size) {
+		uint32_t boundary = layout->branchBoundary;
+		if (boundary == 0)
+			return;
+		uint32_t start = codePos, end = codePos + size;
+		bool crosses = start / boundary != (end - 1) / boundary;
+		bool endsAtBoundary = layout->avoidBranchEnd && end % boundary == 0;
+		if (crosses || endsAtBoundary)
+			genNops(boundary - start % boundary);
+	}
+
+	/*
+		Returns the position in the compiled order after the last write to
+		either of the two address registers of the next iteration.
+	*/
+	static unsigned prefetchPosition(Program& prog, const uint8_t* order, uint32_t readReg0, uint32_t readReg1) {
+		unsigned pos = 0;
+		for (unsigned i = 0; i < ProgramLength; ++i) {
+			Instruction& instr = prog(order != nullptr ? order[i] : i);
+			uint16_t operands = instructionOperands[instructionType[instr.opcode]];
+			bool writesDst = (operands & WriteDst) && (instr.dst == readReg0 || instr.dst == readReg1);
+			bool writesSrc = (operands & WriteSrc) && (instr.src == readReg0 || instr.src == readReg1);
+			if (writesDst || writesSrc)
+				pos = i + 1;
+		}
+		return pos;
+	}
+
 	void JitCompilerX86::generateProgram(Program& prog) {
 		auto addressRegisters = prog.getEntropy(12);
 		uint32_t readReg0 = 0 + (addressRegisters & 1);
@@ -195,211 +370,604 @@ namespace RandomX {
 		emitByte(0xc0 + readReg1);
 		memcpy(code + codePos, codeLoopLoad, loopLoadSize);
 		codePos += loopLoadSize;
+		const int32_t bodyOffset = codePos;
+		const bool logCode = perfLog != nullptr && perfLog->isJitDump();
+		const bool logInstructions = logCode && perfLog->hasInstructionMarkers();
+		markers.clear();
 		for (unsigned i = 0; i < ProgramLength; ++i) {
 			Instruction& instr = prog(i);
 			instr.src %= RegistersCount;
 			instr.dst %= RegistersCount;
-			generateCode(instr);
 		}
+		for (unsigned i = 0; i < RegistersCount; ++i) {
+			registerMap[i] = i;
+		}
+		laneSwapped = 0;
+		invalidateAddresses((1 << Rax) | (1 << Rcx));
+		const uint8_t* order = scheduling ? scheduler.schedule(prog) : nullptr;
+		unsigned prefetchPos = prefetching ? prefetchPosition(prog, order, readReg0, readReg1) : ProgramLength + 1;
+		for (unsigned i = 0; i < ProgramLength; ++i) {
+			if (i == prefetchPos) {
+				if (logInstructions)
+					addMarker(0, "prefetch");
+				genScratchpadPrefetch(readReg0, readReg1);
+			}
+			unsigned index = order != nullptr ? order[i] : i;
+			Instruction& instr = prog(index);
+			if (logInstructions)
+				addMarker(index + 1, instr.getName());
+			if (renaming)
+				generateRenamed(instr);
+			else
+				generateCode(instr);
+		}
+		if (logInstructions)
+			addMarker(0, prefetchPos == ProgramLength ? "prefetch" : "restore");
+		if (prefetchPos == ProgramLength)
+			genScratchpadPrefetch(readReg0, readReg1);
+		if (renaming)
+			restoreRegisters();
+		//no register needed restoring, the marker would point past the program body
+		if (logInstructions && markers.back().offset == (uint32_t)codePos)
+			markers.pop_back();
+		const int32_t readDatasetOffset = codePos;
 		emit(REX_MOV_RR);
 		emitByte(0xc0 + readReg2);
 		emit(REX_XOR_EAX);
 		emitByte(0xc0 + readReg3);
 		memcpy(code + codePos, codeReadDataset, readDatasetSize);
 		codePos += readDatasetSize;
+		const int32_t loopStoreOffset = codePos;
 		memcpy(code + codePos, codeLoopStore, loopStoreSize);
 		codePos += loopStoreSize;
+		alignBranch(sizeof(SUB_EBX) + sizeof(JNZ) + 4);
 		emit(SUB_EBX);
 		emit(JNZ);
 		emit32(prologueSize - codePos - 4);
+		alignBranch(5);
 		emitByte(JMP);
 		emit32(epilogueOffset - codePos - 4);
 		emitByte(0x90);
+		if (logCode) {
+			perfLog->addCode(code, exec, prologueSize, bodyOffset - prologueSize, "loop_load");
+			perfLog->addCode(code, exec, bodyOffset, readDatasetOffset - bodyOffset, "program", logInstructions ? &markers : nullptr);
+			perfLog->addCode(code, exec, readDatasetOffset, loopStoreOffset - readDatasetOffset, "read_dataset");
+			perfLog->addCode(code, exec, loopStoreOffset, codePos - loopStoreOffset, "loop_store");
+		}
+	}
+
+	/*
+		Compiles only the program body as the loop, without the scratchpad loads
+		and stores and the dataset read of a VM iteration. The registers are
+		loaded once from the register file (rcx points 120 bytes into it after
+		the prologue). Used to measure the cost of the generated instructions.
+	*/
+	void JitCompilerX86::generateBody(Program& prog) {
+		codePos = prologueSize;
+		for (unsigned i = 0; i < RegistersCount; ++i) {
+			//mov r8+i, qword ptr [rcx-120+8*i]
+			emit(REX_MOV_R64R);
+			emitByte(0x41 + 8 * i);
+			emitByte(8 * i - 120);
+		}
+		for (unsigned i = 0; i < RegistersCount; ++i) {
+			//movapd xmm0+i, xmmword ptr [rcx-56+16*i] (F and E registers)
+			emit(MOVAPD_RM);
+			emitByte(0x41 + 8 * i);
+			emitByte(16 * i - 56);
+		}
+		genNops((64 - codePos % 64) % 64);
+		const int32_t loopBegin = codePos;
+		for (unsigned i = 0; i < ProgramLength; ++i) {
+			Instruction& instr = prog(i);
+			instr.src %= RegistersCount;
+			instr.dst %= RegistersCount;
+		}
+		for (unsigned i = 0; i < RegistersCount; ++i) {
+			registerMap[i] = i;
+		}
+		laneSwapped = 0;
+		invalidateAddresses((1 << Rax) | (1 << Rcx));
+		const uint8_t* order = scheduling ? scheduler.schedule(prog) : nullptr;
+		for (unsigned i = 0; i < ProgramLength; ++i) {
+			Instruction& instr = prog(order != nullptr ? order[i] : i);
+			if (renaming)
+				generateRenamed(instr);
+			else
+				generateCode(instr);
+		}
+		if (renaming)
+			restoreRegisters();
+		alignBranch(sizeof(SUB_EBX) + sizeof(JNZ) + 4);
+		emit(SUB_EBX);
+		emit(JNZ);
+		emit32(loopBegin - codePos - 4);
+		alignBranch(5);
+		emitByte(JMP);
+		emit32(epilogueOffset - codePos - 4);
+		emitByte(0x90);
+	}
+
+	static inline uint32_t addressMask(Instruction& instr) {
+		return (instr.mod % 4) ? ScratchpadL1Mask : ScratchpadL2Mask;
+	}
+
+	static inline uint32_t addressMask16(Instruction& instr) {
+		return (instr.mod % 4) ? ScratchpadL1Mask16 : ScratchpadL2Mask16;
+	}
+
+	static inline uint32_t addressImm(Instruction& instr) {
+		return instr.imm32 & ScratchpadL3Mask;
+	}
+
+	/*
+		Pre-assembled instruction templates. The templates of memory instructions
+		expect the scratchpad address in rax (rcx for IMULH_M and ISMULH_M), which
+		is computed by genAddressReg. Register fields and immediates are patched
+		at the offsets noted below.
+	*/
+
+	//[2] += src, [4] = mask
+	static const uint8_t ADDR_RAX_TMPL[] = { 0x41, 0x8b, 0xc0, 0x25, 0x00, 0x00, 0x00, 0x00 };
+	//[2] += src, [5] = mask
+	static const uint8_t ADDR_RCX_TMPL[] = { 0x41, 0x8b, 0xc8, 0x81, 0xe1, 0x00, 0x00, 0x00, 0x00 };
+	//[2] += 8 * dst + src
+	static const uint8_t IADD_RR_TMPL[] = { 0x4d, 0x03, 0xc0 };
+	static const uint8_t ISUB_RR_TMPL[] = { 0x4d, 0x2b, 0xc0 };
+	static const uint8_t IXOR_RR_TMPL[] = { 0x4d, 0x33, 0xc0 };
+	//[2] += dst, [3] = imm32
+	static const uint8_t IADD_RI_TMPL[] = { 0x49, 0x81, 0xc0, 0x00, 0x00, 0x00, 0x00 };
+	static const uint8_t ISUB_RI_TMPL[] = { 0x49, 0x81, 0xe8, 0x00, 0x00, 0x00, 0x00 };
+	static const uint8_t IXOR_RI_TMPL[] = { 0x49, 0x81, 0xf0, 0x00, 0x00, 0x00, 0x00 };
+	//[2] += 8 * dst
+	static const uint8_t IADD_RM_TMPL[] = { 0x4c, 0x03, 0x04, 0x06 };
+	static const uint8_t ISUB_RM_TMPL[] = { 0x4c, 0x2b, 0x04, 0x06 };
+	static const uint8_t IXOR_RM_TMPL[] = { 0x4c, 0x33, 0x04, 0x06 };
+	//[2] += 8 * dst, [3] = address
+	static const uint8_t IADD_RMI_TMPL[] = { 0x4c, 0x03, 0x86, 0x00, 0x00, 0x00, 0x00 };
+	static const uint8_t ISUB_RMI_TMPL[] = { 0x4c, 0x2b, 0x86, 0x00, 0x00, 0x00, 0x00 };
+	static const uint8_t IXOR_RMI_TMPL[] = { 0x4c, 0x33, 0x86, 0x00, 0x00, 0x00, 0x00 };
+	//[2] += 8 * dst, [3] = SIB, [4] = imm32
+	static const uint8_t LEA_SIB_TMPL[] = { 0x4f, 0x8d, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	//[3] += 8 * dst + src
+	static const uint8_t IMUL_RR_TMPL[] = { 0x4d, 0x0f, 0xaf, 0xc0 };
+	//[2] += 9 * dst, [3] = imm32
+	static const uint8_t IMUL_RRI_TMPL[] = { 0x4d, 0x69, 0xc0, 0x00, 0x00, 0x00, 0x00 };
+	//[3] += 8 * dst
+	static const uint8_t IMUL_RM_TMPL[] = { 0x4c, 0x0f, 0xaf, 0x04, 0x06 };
+	//[3] += 8 * dst, [4] = address
+	static const uint8_t IMUL_RMI_TMPL[] = { 0x4c, 0x0f, 0xaf, 0x86, 0x00, 0x00, 0x00, 0x00 };
+	//[2] += dst, [5] += src, [8] += 8 * dst
+	static const uint8_t IMULH_R_TMPL[] = { 0x49, 0x8b, 0xc0, 0x49, 0xf7, 0xe0, 0x4c, 0x8b, 0xc2 };
+	static const uint8_t ISMULH_R_TMPL[] = { 0x49, 0x8b, 0xc0, 0x49, 0xf7, 0xe8, 0x4c, 0x8b, 0xc2 };
+	//[2] += dst, [9] += 8 * dst
+	static const uint8_t IMULH_M_TMPL[] = { 0x49, 0x8b, 0xc0, 0x48, 0xf7, 0x24, 0x0e, 0x4c, 0x8b, 0xc2 };
+	static const uint8_t ISMULH_M_TMPL[] = { 0x49, 0x8b, 0xc0, 0x48, 0xf7, 0x2c, 0x0e, 0x4c, 0x8b, 0xc2 };
+	//[2] += dst, [6] = address, [12] += 8 * dst
+	static const uint8_t IMULH_MI_TMPL[] = { 0x49, 0x8b, 0xc0, 0x48, 0xf7, 0xa6, 0x00, 0x00, 0x00, 0x00, 0x4c, 0x8b, 0xc2 };
+	static const uint8_t ISMULH_MI_TMPL[] = { 0x49, 0x8b, 0xc0, 0x48, 0xf7, 0xae, 0x00, 0x00, 0x00, 0x00, 0x4c, 0x8b, 0xc2 };
+	//[2] += dst
+	static const uint8_t INEG_R_TMPL[] = { 0x49, 0xf7, 0xd8 };
+	//[2] += src, [5] += dst
+	static const uint8_t IROR_RR_TMPL[] = { 0x41, 0x8b, 0xc8, 0x49, 0xd3, 0xc8 };
+	static const uint8_t IROL_RR_TMPL[] = { 0x41, 0x8b, 0xc8, 0x49, 0xd3, 0xc0 };
+	//[2] += dst, [3] = imm8
+	static const uint8_t IROR_RI_TMPL[] = { 0x49, 0xc1, 0xc8, 0x00 };
+	static const uint8_t IROL_RI_TMPL[] = { 0x49, 0xc1, 0xc0, 0x00 };
+	//[2] += dst + 8 * src
+	static const uint8_t ISWAP_R_TMPL[] = { 0x4d, 0x87, 0xc0 };
+	//[3] += 9 * dst
+	static const uint8_t FSWAP_R_TMPL[] = { 0x66, 0x0f, 0xc6, 0xc0, 0x01 };
+	//[4] += src + 8 * dst
+	static const uint8_t FADD_R_TMPL[] = { 0x66, 0x41, 0x0f, 0x58, 0xc0 };
+	static const uint8_t FSUB_R_TMPL[] = { 0x66, 0x41, 0x0f, 0x5c, 0xc0 };
+	static const uint8_t FMUL_R_TMPL[] = { 0x66, 0x41, 0x0f, 0x59, 0xe0 };
+	//[4] += src + 8 * dst, [9] += 8 * dst
+	static const uint8_t FDIV_R_TMPL[] = { 0x66, 0x41, 0x0f, 0x5e, 0xe0, 0x66, 0x41, 0x0f, 0x5f, 0xe5 };
+	//[10] += 8 * dst
+	static const uint8_t FADD_M_TMPL[] = { 0xf3, 0x44, 0x0f, 0xe6, 0x24, 0x06, 0x66, 0x41, 0x0f, 0x58, 0xc4 };
+	static const uint8_t FSUB_M_TMPL[] = { 0xf3, 0x44, 0x0f, 0xe6, 0x24, 0x06, 0x66, 0x41, 0x0f, 0x5c, 0xc4 };
+	//[14] += 8 * dst, [19] += 8 * dst
+	static const uint8_t FMUL_M_TMPL[] = { 0xf3, 0x44, 0x0f, 0xe6, 0x24, 0x06, 0x45, 0x0f, 0x54, 0xe6, 0x66, 0x41, 0x0f, 0x59, 0xe4, 0x66, 0x41, 0x0f, 0x5f, 0xe5 };
+	static const uint8_t FDIV_M_TMPL[] = { 0xf3, 0x44, 0x0f, 0xe6, 0x24, 0x06, 0x45, 0x0f, 0x54, 0xe6, 0x66, 0x41, 0x0f, 0x5e, 0xe4, 0x66, 0x41, 0x0f, 0x5f, 0xe5 };
+	//[3] += 8 * dst
+	static const uint8_t FSCAL_R_TMPL[] = { 0x41, 0x0f, 0x57, 0xc7 };
+	//[3] += 9 * dst
+	static const uint8_t FSQRT_R_TMPL[] = { 0x66, 0x0f, 0x51, 0xe4 };
+	//[4] += src, [5] = imm32, [10] = setcc, [14] += 8 * dst
+	static const uint8_t COND_R_TMPL[] = { 0x33, 0xc9, 0x41, 0x81, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x00, 0xc1, 0x4c, 0x03, 0xc1 };
+	//[3] = imm32, [8] = setcc, [12] += 8 * dst
+	static const uint8_t COND_M_TMPL[] = { 0x81, 0x3c, 0x06, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x00, 0xc1, 0x4c, 0x03, 0xc1 };
+	//[2] += 8 * src
+	static const uint8_t ISTORE_TMPL[] = { 0x4c, 0x89, 0x04, 0x06 };
+	//[3] += 8 * src
+	static const uint8_t FSTORE_TMPL[] = { 0x66, 0x0f, 0x29, 0x04, 0x06 };
+
+	/*
+		VEX (AVX) and BMI2 templates. The VEX forms of the floating point
+		instructions compute the same results as the SSE2 forms. mulx and rorx
+		don't use rax or the flags.
+	*/
+
+	//[2] += dst, [5] -= 8 * dst, [7] += 8 * dst + src
+	static const uint8_t MULX_R_TMPL[] = { 0x49, 0x8b, 0xd0, 0xc4, 0x42, 0xbb, 0xf6, 0xc0 };
+	//[2] += dst, [5] -= 8 * dst, [7] += 8 * dst
+	static const uint8_t MULX_M_TMPL[] = { 0x49, 0x8b, 0xd0, 0xc4, 0x62, 0xbb, 0xf6, 0x04, 0x0e };
+	//[2] += dst, [5] -= 8 * dst, [7] += 8 * dst, [8] = address
+	static const uint8_t MULX_MI_TMPL[] = { 0x49, 0x8b, 0xd0, 0xc4, 0x62, 0xbb, 0xf6, 0x86, 0x00, 0x00, 0x00, 0x00 };
+	//[4] += 9 * dst, [5] = imm8
+	static const uint8_t RORX_TMPL[] = { 0xc4, 0x43, 0xfb, 0xf0, 0xc0, 0x00 };
+	//[4] += 9 * dst
+	static const uint8_t VFSWAP_R_TMPL[] = { 0xc4, 0xe3, 0x79, 0x05, 0xc0, 0x01 };
+	//[2] -= 8 * dst, [4] += src + 8 * dst
+	static const uint8_t VFADD_R_TMPL[] = { 0xc4, 0xc1, 0x79, 0x58, 0xc0 };
+	static const uint8_t VFSUB_R_TMPL[] = { 0xc4, 0xc1, 0x79, 0x5c, 0xc0 };
+	static const uint8_t VFMUL_R_TMPL[] = { 0xc4, 0xc1, 0x59, 0x59, 0xe0 };
+	//[2] -= 8 * dst, [4] += src + 8 * dst, [7] -= 8 * dst, [9] += 8 * dst
+	static const uint8_t VFDIV_R_TMPL[] = { 0xc4, 0xc1, 0x59, 0x5e, 0xe0, 0xc4, 0xc1, 0x59, 0x5f, 0xe5 };
+	//[8] -= 8 * dst, [10] += 8 * dst
+	static const uint8_t VFADD_M_TMPL[] = { 0xc4, 0x61, 0x7a, 0xe6, 0x24, 0x06, 0xc4, 0xc1, 0x79, 0x58, 0xc4 };
+	static const uint8_t VFSUB_M_TMPL[] = { 0xc4, 0x61, 0x7a, 0xe6, 0x24, 0x06, 0xc4, 0xc1, 0x79, 0x5c, 0xc4 };
+	//[13] -= 8 * dst, [15] += 8 * dst, [18] -= 8 * dst, [20] += 8 * dst
+	static const uint8_t VFMUL_M_TMPL[] = { 0xc4, 0x61, 0x7a, 0xe6, 0x24, 0x06, 0xc4, 0x41, 0x18, 0x54, 0xe6, 0xc4, 0xc1, 0x59, 0x59, 0xe4, 0xc4, 0xc1, 0x59, 0x5f, 0xe5 };
+	static const uint8_t VFDIV_M_TMPL[] = { 0xc4, 0x61, 0x7a, 0xe6, 0x24, 0x06, 0xc4, 0x41, 0x18, 0x54, 0xe6, 0xc4, 0xc1, 0x59, 0x5e, 0xe4, 0xc4, 0xc1, 0x59, 0x5f, 0xe5 };
+	//[2] -= 8 * dst, [4] += 8 * dst
+	static const uint8_t VFSCAL_R_TMPL[] = { 0xc4, 0xc1, 0x78, 0x57, 0xc7 };
+	//[3] += 9 * dst
+	static const uint8_t VFSQRT_R_TMPL[] = { 0xc5, 0xf9, 0x51, 0xe4 };
+
+	//[11] = 8 * readReg0, [16] = 8 * readReg1, [19] += reg0, [22] += reg1
+	static const uint8_t PREFETCH_SCRATCHPAD_TMPL[] = {
+		0x48, 0x8b, 0xd5,                         //mov rdx, rbp
+		0x48, 0xc1, 0xea, 0x20,                   //shr rdx, 32
+		0x48, 0x8b, 0x44, 0x17, 0x00,             //mov rax, [rdi+rdx+8*readReg0]
+		0x48, 0x33, 0x44, 0x17, 0x00,             //xor rax, [rdi+rdx+8*readReg1]
+		0x49, 0x33, 0xc0,                         //xor rax, reg0
+		0x49, 0x33, 0xc0,                         //xor rax, reg1
+		0x8b, 0xd0,                               //mov edx, eax
+		0x81, 0xe2, 0xc0, 0xff, 0x1f, 0x00,       //and edx, ScratchpadL3Mask64
+		0x0f, 0x18, 0x0c, 0x16,                   //prefetcht0 [rsi+rdx]
+		0x48, 0xc1, 0xe8, 0x20,                   //shr rax, 32
+		0x25, 0xc0, 0xff, 0x1f, 0x00,             //and eax, ScratchpadL3Mask64
+		0x0f, 0x18, 0x0c, 0x06,                   //prefetcht0 [rsi+rax]
+	};
+
+	/*
+		Prefetches the scratchpad lines loaded at the start of the next iteration.
+		Their addresses depend on readReg0 and readReg1 after the dataset line is
+		xored into the registers at the end of the iteration. That line is already
+		known (upper half of rbp) and was prefetched one iteration earlier, so the
+		addresses can be computed as soon as the program body stops writing the
+		two registers.
+	*/
+	void JitCompilerX86::genScratchpadPrefetch(uint32_t readReg0, uint32_t readReg1) {
+		static_assert(ScratchpadL3Mask64 == 0x1fffc0, "PREFETCH_SCRATCHPAD_TMPL must be updated");
+		uint8_t* p = emitTemplate(PREFETCH_SCRATCHPAD_TMPL);
+		p[11] = 8 * readReg0;
+		p[16] = 8 * readReg1;
+		p[19] += registerMap[readReg0];
+		p[22] += registerMap[readReg1];
+		invalidateAddresses(1 << Rax);
 	}
 
 	void JitCompilerX86::generateCode(Instruction& instr) {
+		int type = instructionType[instr.opcode];
+		uint16_t operands = instructionOperands[type];
+		int dst = instr.dst, src = instr.src;
 		auto generator = engine[instr.opcode];
 		(this->*generator)(instr);
+		//an address stays valid until its temporary or its source register is overwritten
+		uint32_t temps = temporaryRegisters[type];
+		for (int i = 0; i < 2; ++i) {
+			int reg = cachedAddress[i].reg;
+			if (((operands & WriteDst) && reg == dst) || ((operands & WriteSrc) && reg == src))
+				temps |= 1 << i;
+		}
+		invalidateAddresses(temps);
 	}
 
-	void JitCompilerX86::genAddressReg(Instruction& instr, bool rax = true) {
-		emit(REX_MOV_RR);
-		emitByte((rax ? 0xc0 : 0xc8) + instr.src);
-		if (rax)
-			emitByte(AND_EAX_I);
-		else
-			emit(AND_ECX_I);
-		emit32((instr.mod % 4) ? ScratchpadL1Mask : ScratchpadL2Mask);
+	/*
+		Emits 'mov eax, r32; and eax, mask' (or the same with ecx) unless the
+		temporary still holds that address from a previous memory instruction.
+	*/
+	void JitCompilerX86::genAddressReg(int reg, uint32_t mask, int temp) {
+		CachedAddress& cached = cachedAddress[temp];
+		if (cached.reg == reg && cached.mask == mask)
+			return;
+		if (temp == Rax) {
+			uint8_t* p = emitTemplate(ADDR_RAX_TMPL);
+			p[2] += reg;
+			store32(p + 4, mask);
+		}
+		else {
+			uint8_t* p = emitTemplate(ADDR_RCX_TMPL);
+			p[2] += reg;
+			store32(p + 5, mask);
+		}
+		cached.reg = reg;
+		cached.mask = mask;
 	}
 
-	void JitCompilerX86::genAddressRegDst(Instruction& instr, bool align16 = false) {
-		emit(REX_MOV_RR);
-		emitByte(0xc0 + instr.dst);
-		emitByte(AND_EAX_I);
-		int32_t maskL1 = align16 ? ScratchpadL1Mask16 : ScratchpadL1Mask;
-		int32_t maskL2 = align16 ? ScratchpadL2Mask16 : ScratchpadL2Mask;
-		emit32((instr.mod % 4) ? maskL1 : maskL2);
+	void JitCompilerX86::invalidateAddresses(uint32_t temps) {
+		for (int i = 0; i < 2; ++i) {
+			if (temps & (1 << i))
+				cachedAddress[i].reg = -1;
+		}
+	}
+
+	/*
+		Register renaming. ISWAP_R only exchanges the registers that hold two
+		program registers, so instead of emitting it, the compiler swaps their
+		entries in registerMap and encodes the following instructions with the
+		renamed registers. FSWAP_R is deferred until the xmm register is used by
+		an instruction that treats its two halves differently, which cancels
+		pairs of swaps. The identity mapping is restored at the end of the
+		program body, because the loop, the dataset read and the register
+		store code use the fixed register allocation.
+	*/
+	void JitCompilerX86::generateRenamed(Instruction& instr) {
+		int type = instructionType[instr.opcode];
+		uint16_t operands = instructionOperands[type];
+		if (type == InstructionType::ISWAP_R) {
+			std::swap(registerMap[instr.dst], registerMap[instr.src]);
+			return;
+		}
+		if (type == InstructionType::FSWAP_R) {
+			laneSwapped ^= 1 << instr.dst;
+			return;
+		}
+		uint32_t xmm = 0;
+		xmm |= (operands & FloatDst) ? 1 << (instr.dst % 4) : 0;
+		xmm |= (operands & MulDst) ? 1 << (4 + instr.dst % 4) : 0;
+		xmm |= (operands & XmmSrc) ? 1 << instr.src : 0;
+		xmm = (operands & LaneSymmetric) ? 0 : xmm & laneSwapped;
+		if (xmm != 0)
+			emitLaneSwaps(xmm);
+		Instruction renamed = instr;
+		renamed.dst = (operands & (ReadDst | WriteDst)) ? registerMap[instr.dst] : instr.dst;
+		renamed.src = (operands & (ReadSrc | WriteSrc)) ? registerMap[instr.src] : instr.src;
+		generateCode(renamed);
 	}
 
-	void JitCompilerX86::genAddressImm(Instruction& instr) {
-		emit32(instr.imm32 & ScratchpadL3Mask);
+	void JitCompilerX86::emitLaneSwaps(uint32_t xmm) {
+		for (int i = 0; i < 8; ++i) {
+			if (xmm & (1 << i))
+				genLaneSwap(i);
+		}
+		laneSwapped &= ~xmm;
+	}
+
+	void JitCompilerX86::restoreRegisters() {
+		if (laneSwapped != 0)
+			emitLaneSwaps(laneSwapped);
+		//one xchg puts at least one register in place, a cycle of n registers needs n - 1
+		for (unsigned i = 0; i < RegistersCount; ++i) {
+			if (registerMap[i] == i)
+				continue;
+			unsigned j = i + 1;
+			while (registerMap[j] != i)
+				++j;
+			uint8_t* p = emitTemplate(ISWAP_R_TMPL);
+			p[2] += i + 8 * registerMap[i];
+			registerMap[j] = registerMap[i];
+			registerMap[i] = i;
+		}
 	}
 
 	void JitCompilerX86::h_IADD_R(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			emit(REX_ADD_RR);
-			emitByte(0xc0 + 8 * instr.dst + instr.src);
+			uint8_t* p = emitTemplate(IADD_RR_TMPL);
+			p[2] += 8 * instr.dst + instr.src;
 		}
 		else {
-			emit(REX_81);
-			emitByte(0xc0 + instr.dst);
-			emit32(instr.imm32);
+			uint8_t* p = emitTemplate(IADD_RI_TMPL);
+			p[2] += instr.dst;
+			store32(p + 3, instr.imm32);
 		}
 	}
 
 	void JitCompilerX86::h_IADD_M(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			genAddressReg(instr);
-			emit(REX_ADD_RM);
-			emitByte(0x04 + 8 * instr.dst);
-			emitByte(0x06);
+			genAddressReg(instr.src, addressMask(instr), Rax);
+			uint8_t* p = emitTemplate(IADD_RM_TMPL);
+			p[2] += 8 * instr.dst;
 		}
 		else {
-			emit(REX_ADD_RM);
-			emitByte(0x86 + 8 * instr.dst);
-			genAddressImm(instr);
+			uint8_t* p = emitTemplate(IADD_RMI_TMPL);
+			p[2] += 8 * instr.dst;
+			store32(p + 3, addressImm(instr));
 		}
 	}
 
-	void JitCompilerX86::genSIB(int scale, int index, int base) {
-		emitByte((scale << 5) | (index << 3) | base);
-	}
-
 	void JitCompilerX86::h_IADD_RC(Instruction& instr) {
-		emit(REX_LEA);
-		emitByte(0x84 + 8 * instr.dst);
-		genSIB(0, instr.src, instr.dst);
-		emit32(instr.imm32);
+		uint8_t* p = emitTemplate(LEA_SIB_TMPL);
+		p[2] += 8 * instr.dst;
+		p[3] = (instr.src << 3) | instr.dst;
+		store32(p + 4, instr.imm32);
 	}
 
 	void JitCompilerX86::h_ISUB_R(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			emit(REX_SUB_RR);
-			emitByte(0xc0 + 8 * instr.dst + instr.src);
+			uint8_t* p = emitTemplate(ISUB_RR_TMPL);
+			p[2] += 8 * instr.dst + instr.src;
 		}
 		else {
-			emit(REX_81);
-			emitByte(0xe8 + instr.dst);
-			genAddressImm(instr);
+			uint8_t* p = emitTemplate(ISUB_RI_TMPL);
+			p[2] += instr.dst;
+			store32(p + 3, addressImm(instr));
 		}
 	}
 
 	void JitCompilerX86::h_ISUB_M(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			genAddressReg(instr);
-			emit(REX_SUB_RM);
-			emitByte(0x04 + 8 * instr.dst);
-			emitByte(0x06);
+			genAddressReg(instr.src, addressMask(instr), Rax);
+			uint8_t* p = emitTemplate(ISUB_RM_TMPL);
+			p[2] += 8 * instr.dst;
 		}
 		else {
-			emit(REX_SUB_RM);
-			emitByte(0x86 + 8 * instr.dst);
-			genAddressImm(instr);
+			uint8_t* p = emitTemplate(ISUB_RMI_TMPL);
+			p[2] += 8 * instr.dst;
+			store32(p + 3, addressImm(instr));
 		}
 	}
 
 	void JitCompilerX86::h_IMUL_9C(Instruction& instr) {
-		emit(REX_LEA);
-		emitByte(0x84 + 8 * instr.dst);
-		genSIB(3, instr.src, instr.dst);
-		emit32(instr.imm32);
+		uint8_t* p = emitTemplate(LEA_SIB_TMPL);
+		p[2] += 8 * instr.dst;
+		p[3] = (3 << 6) | (instr.dst << 3) | instr.dst;
+		store32(p + 4, instr.imm32);
 	}
 
 	void JitCompilerX86::h_IMUL_R(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			emit(REX_IMUL_RR);
-			emitByte(0xc0 + 8 * instr.dst + instr.src);
+			uint8_t* p = emitTemplate(IMUL_RR_TMPL);
+			p[3] += 8 * instr.dst + instr.src;
 		}
 		else {
-			emit(REX_IMUL_RRI);
-			emitByte(0xc0 + 9 * instr.dst);
-			genAddressImm(instr);
+			uint8_t* p = emitTemplate(IMUL_RRI_TMPL);
+			p[2] += 9 * instr.dst;
+			store32(p + 3, addressImm(instr));
 		}
 	}
 
 	void JitCompilerX86::h_IMUL_M(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			genAddressReg(instr);
-			emit(REX_IMUL_RM);
-			emitByte(0x04 + 8 * instr.dst);
-			emitByte(0x06);
+			genAddressReg(instr.src, addressMask(instr), Rax);
+			uint8_t* p = emitTemplate(IMUL_RM_TMPL);
+			p[3] += 8 * instr.dst;
 		}
 		else {
-			emit(REX_IMUL_RM);
-			emitByte(0x86 + 8 * instr.dst);
-			genAddressImm(instr);
+			uint8_t* p = emitTemplate(IMUL_RMI_TMPL);
+			p[3] += 8 * instr.dst;
+			store32(p + 4, addressImm(instr));
 		}
 	}
 
 	void JitCompilerX86::h_IMULH_R(Instruction& instr) {
-		emit(REX_MOV_RR64);
-		emitByte(0xc0 + instr.dst);
-		emit(REX_MUL_R);
-		emitByte(0xe0 + instr.src);
-		emit(REX_MOV_R64R);
-		emitByte(0xc2 + 8 * instr.dst);
+		if (bmi2) {
+			uint8_t* p = emitTemplate(MULX_R_TMPL);
+			p[2] += instr.dst;
+			p[5] -= 8 * instr.dst;
+			p[7] += 8 * instr.dst + instr.src;
+		}
+		else {
+			uint8_t* p = emitTemplate(IMULH_R_TMPL);
+			p[2] += instr.dst;
+			p[5] += instr.src;
+			p[8] += 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_IMULH_M(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			genAddressReg(instr, false);
-			emit(REX_MOV_RR64);
-			emitByte(0xc0 + instr.dst);
-			emit(REX_MUL_MEM);
+			genAddressReg(instr.src, addressMask(instr), Rcx);
+			if (bmi2) {
+				uint8_t* p = emitTemplate(MULX_M_TMPL);
+				p[2] += instr.dst;
+				p[5] -= 8 * instr.dst;
+				p[7] += 8 * instr.dst;
+			}
+			else {
+				uint8_t* p = emitTemplate(IMULH_M_TMPL);
+				p[2] += instr.dst;
+				p[9] += 8 * instr.dst;
+			}
+		}
+		else if (bmi2) {
+			uint8_t* p = emitTemplate(MULX_MI_TMPL);
+			p[2] += instr.dst;
+			p[5] -= 8 * instr.dst;
+			p[7] += 8 * instr.dst;
+			store32(p + 8, addressImm(instr));
 		}
 		else {
-			emit(REX_MOV_RR64);
-			emitByte(0xc0 + instr.dst);
-			emit(REX_MUL_M);
-			emitByte(0xa6);
-			genAddressImm(instr);
+			uint8_t* p = emitTemplate(IMULH_MI_TMPL);
+			p[2] += instr.dst;
+			store32(p + 6, addressImm(instr));
+			p[12] += 8 * instr.dst;
 		}
-		emit(REX_MOV_R64R);
-		emitByte(0xc2 + 8 * instr.dst);
 	}
 
 	void JitCompilerX86::h_ISMULH_R(Instruction& instr) {
-		emit(REX_MOV_RR64);
-		emitByte(0xc0 + instr.dst);
-		emit(REX_MUL_R);
-		emitByte(0xe8 + instr.src);
-		emit(REX_MOV_R64R);
-		emitByte(0xc2 + 8 * instr.dst);
+		uint8_t* p = emitTemplate(ISMULH_R_TMPL);
+		p[2] += instr.dst;
+		p[5] += instr.src;
+		p[8] += 8 * instr.dst;
 	}
 
 	void JitCompilerX86::h_ISMULH_M(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			genAddressReg(instr, false);
-			emit(REX_MOV_RR64);
-			emitByte(0xc0 + instr.dst);
-			emit(REX_IMUL_MEM);
+			genAddressReg(instr.src, addressMask(instr), Rcx);
+			uint8_t* p = emitTemplate(ISMULH_M_TMPL);
+			p[2] += instr.dst;
+			p[9] += 8 * instr.dst;
 		}
 		else {
-			emit(REX_MOV_RR64);
-			emitByte(0xc0 + instr.dst);
-			emit(REX_MUL_M);
-			emitByte(0xae);
-			genAddressImm(instr);
+			uint8_t* p = emitTemplate(ISMULH_MI_TMPL);
+			p[2] += instr.dst;
+			store32(p + 6, addressImm(instr));
+			p[12] += 8 * instr.dst;
 		}
-		emit(REX_MOV_R64R);
-		emitByte(0xc2 + 8 * instr.dst);
+	}
+
+	static inline unsigned bitLength(uint64_t x) {
+		unsigned length = 0;
+		for (; x >= 256; x >>= 8)
+			length += 8;
+		for (; x > 0; x >>= 1)
+			length += 1;
+		return length;
+	}
+
+	/*
+		Same result as compute_unsigned_magic_info(divisor, 64 - extraShift), but the
+		smallest round-up exponent is found directly from the first differing bit of
+		the binary expansions of r/divisor and (r + 2^extraShift)/divisor, where
+		r = 2^64 mod divisor, instead of one exponent at a time. Divisors must be
+		less than 2^32 and not a power of two.
+	*/
+	static magicu_info unsignedMagic(uint64_t divisor, unsigned extraShift = 0) {
+		const unsigned ceilLog2 = bitLength(divisor);
+		const uint64_t quotient = UINT64_MAX / divisor;
+		const uint64_t remainder = UINT64_MAX % divisor + 1;
+		const uint64_t step = 1ULL << extraShift;
+		const uint64_t fractionLo = (remainder << 32) / divisor;
+		unsigned exponent;
+		if (remainder + step >= divisor) {
+			exponent = 0;
+		}
+		else {
+			uint64_t fractionHi = ((remainder + step) << 32) / divisor;
+			exponent = 33 - bitLength(fractionLo ^ fractionHi);
+		}
+		magicu_info result;
+		if (exponent + extraShift < ceilLog2) {
+			result.multiplier = (quotient << exponent) + (exponent > 0 ? fractionLo >> (32 - exponent) : 0) + 1;
+			result.pre_shift = 0;
+			result.post_shift = exponent;
+			result.increment = 0;
+		}
+		else if (divisor & 1) {
+			//round-down multiplier, rare
+			result = compute_unsigned_magic_info(divisor, 64 - extraShift);
+		}
+		else {
+			unsigned preShift = 0;
+			while ((divisor & 1) == 0) {
+				divisor >>= 1;
+				preShift++;
+			}
+			result = unsignedMagic(divisor, extraShift + preShift);
+			result.pre_shift = preShift;
+		}
+		return result;
 	}
 
 	void JitCompilerX86::h_IDIV_C(Instruction& instr) {
 		if (instr.imm32 != 0) {
 			uint32_t divisor = instr.imm32;
 			if (divisor & (divisor - 1)) {
-				magicu_info mi = compute_unsigned_magic_info(divisor, sizeof(uint64_t) * 8);
+				magicu_info mi = unsignedMagic(divisor);
 				if (mi.pre_shift == 0 && !mi.increment) {
 					emit(MOV_RAX_I);
 					emit64(mi.multiplier);
@@ -424,23 +992,29 @@ namespace RandomX {
 					emit(REX_SHR_RDX);
 					emitByte(mi.post_shift);
 				}
-				emit(REX_ADD_RR);
-				emitByte(0xc2 + 8 * instr.dst);
+				emit(ADD_R_RAX);
+				emitByte(0xd0 + instr.dst);
 			}
 			else { //divisor is a power of two
 				int shift = 0;
 				while (divisor >>= 1)
 					++shift;
+				emit(REX_MOV_RR64);
+				emitByte(0xc0 + instr.dst);
 				if (shift > 0) {
-					emit(REX_SH);
-					emitByte(0xe8 + instr.dst);
+					emit(REX_SHR_RAX);
+					emitByte(shift);
 				}
+				emit(ADD_R_RAX);
+				emitByte(0xc0 + instr.dst);
 			}
 		}
 	}
 
 	void JitCompilerX86::h_ISDIV_C(Instruction& instr) {
-		int64_t divisor = instr.imm32;
+		int64_t divisor = (int32_t)instr.imm32;
+		if (divisor == 0)
+			return;
 		if ((divisor & -divisor) == divisor || (divisor & -divisor) == -divisor) {
 			emit(REX_MOV_RR64);
 			emitByte(0xc0 + instr.dst);
@@ -466,7 +1040,7 @@ namespace RandomX {
 			emit(ADD_R_RAX);
 			emitByte(0xc0 + instr.dst);
 		}
-		else if (divisor != 0) {
+		else {
 			magics_info mi = compute_signed_magic_info(divisor);
 			emit(MOV_RAX_I);
 			emit64(mi.multiplier);
@@ -498,161 +1072,231 @@ namespace RandomX {
 	}
 
 	void JitCompilerX86::h_INEG_R(Instruction& instr) {
-		emit(REX_NEG);
-		emitByte(0xd8 + instr.dst);
+		uint8_t* p = emitTemplate(INEG_R_TMPL);
+		p[2] += instr.dst;
 	}
 
 	void JitCompilerX86::h_IXOR_R(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			emit(REX_XOR_RR);
-			emitByte(0xc0 + 8 * instr.dst + instr.src);
+			uint8_t* p = emitTemplate(IXOR_RR_TMPL);
+			p[2] += 8 * instr.dst + instr.src;
 		}
 		else {
-			emit(REX_XOR_RI);
-			emitByte(0xf0 + instr.dst);
-			emit32(instr.imm32);
+			uint8_t* p = emitTemplate(IXOR_RI_TMPL);
+			p[2] += instr.dst;
+			store32(p + 3, instr.imm32);
 		}
 	}
 
 	void JitCompilerX86::h_IXOR_M(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			genAddressReg(instr);
-			emit(REX_XOR_RM);
-			emitByte(0x04 + 8 * instr.dst);
-			emitByte(0x06);
-	}
+			genAddressReg(instr.src, addressMask(instr), Rax);
+			uint8_t* p = emitTemplate(IXOR_RM_TMPL);
+			p[2] += 8 * instr.dst;
+		}
 		else {
-			emit(REX_XOR_RM);
-			emitByte(0x86 + 8 * instr.dst);
-			genAddressImm(instr);
+			uint8_t* p = emitTemplate(IXOR_RMI_TMPL);
+			p[2] += 8 * instr.dst;
+			store32(p + 3, addressImm(instr));
 		}
 	}
 
 	void JitCompilerX86::h_IROR_R(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			emit(REX_MOV_RR);
-			emitByte(0xc8 + instr.src);
-			emit(REX_ROT_CL);
-			emitByte(0xc8 + instr.dst);
+			uint8_t* p = emitTemplate(IROR_RR_TMPL);
+			p[2] += instr.src;
+			p[5] += instr.dst;
+		}
+		else if (bmi2) {
+			uint8_t* p = emitTemplate(RORX_TMPL);
+			p[4] += 9 * instr.dst;
+			p[5] = instr.imm32 & 63;
 		}
 		else {
-			emit(REX_ROT_I8);
-			emitByte(0xc8 + instr.dst);
-			emitByte(instr.imm32 & 63);
+			uint8_t* p = emitTemplate(IROR_RI_TMPL);
+			p[2] += instr.dst;
+			p[3] = instr.imm32 & 63;
 		}
 	}
 
 	void JitCompilerX86::h_IROL_R(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			emit(REX_MOV_RR);
-			emitByte(0xc8 + instr.src);
-			emit(REX_ROT_CL);
-			emitByte(0xc0 + instr.dst);
+			uint8_t* p = emitTemplate(IROL_RR_TMPL);
+			p[2] += instr.src;
+			p[5] += instr.dst;
+		}
+		else if (bmi2) {
+			uint8_t* p = emitTemplate(RORX_TMPL);
+			p[4] += 9 * instr.dst;
+			p[5] = -instr.imm32 & 63;
 		}
 		else {
-			emit(REX_ROT_I8);
-			emitByte(0xc0 + instr.dst);
-			emitByte(instr.imm32 & 63);
+			uint8_t* p = emitTemplate(IROL_RI_TMPL);
+			p[2] += instr.dst;
+			p[3] = instr.imm32 & 63;
 		}
 	}
 
 	void JitCompilerX86::h_ISWAP_R(Instruction& instr) {
 		if (instr.src != instr.dst) {
-			emit(REX_XCHG);
-			emitByte(0xc0 + instr.dst + 8 * instr.src);
+			uint8_t* p = emitTemplate(ISWAP_R_TMPL);
+			p[2] += instr.dst + 8 * instr.src;
+		}
+	}
+
+	void JitCompilerX86::genLaneSwap(int xmm) {
+		if (avx) {
+			uint8_t* p = emitTemplate(VFSWAP_R_TMPL);
+			p[4] += 9 * xmm;
+		}
+		else {
+			uint8_t* p = emitTemplate(FSWAP_R_TMPL);
+			p[3] += 9 * xmm;
 		}
 	}
 
 	void JitCompilerX86::h_FSWAP_R(Instruction& instr) {
-		emit(SHUFPD);
-		emitByte(0xc0 + 9 * instr.dst);
-		emitByte(1);
+		genLaneSwap(instr.dst);
 	}
 
 	void JitCompilerX86::h_FADD_R(Instruction& instr) {
 		instr.dst %= 4;
 		instr.src %= 4;
-		emit(REX_ADDPD);
-		emitByte(0xc0 + instr.src + 8 * instr.dst);
-		//emit(REX_PADD);
-		//emitByte(PADD_OPCODES[instr.mod % 4]);
-		//emitByte(0xf8 + instr.dst);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFADD_R_TMPL);
+			p[2] -= 8 * instr.dst;
+			p[4] += instr.src + 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FADD_R_TMPL);
+			p[4] += instr.src + 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FADD_M(Instruction& instr) {
 		instr.dst %= 4;
-		genAddressReg(instr);
-		emit(REX_CVTDQ2PD_XMM12);
-		emit(REX_ADDPD);
-		emitByte(0xc4 + 8 * instr.dst);
+		genAddressReg(instr.src, addressMask(instr), Rax);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFADD_M_TMPL);
+			p[8] -= 8 * instr.dst;
+			p[10] += 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FADD_M_TMPL);
+			p[10] += 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FSUB_R(Instruction& instr) {
 		instr.dst %= 4;
 		instr.src %= 4;
-		emit(REX_SUBPD);
-		emitByte(0xc0 + instr.src + 8 * instr.dst);
-		//emit(REX_PADD);
-		//emitByte(PADD_OPCODES[instr.mod % 4]);
-		//emitByte(0xf8 + instr.dst);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFSUB_R_TMPL);
+			p[2] -= 8 * instr.dst;
+			p[4] += instr.src + 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FSUB_R_TMPL);
+			p[4] += instr.src + 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FSUB_M(Instruction& instr) {
 		instr.dst %= 4;
-		genAddressReg(instr);
-		emit(REX_CVTDQ2PD_XMM12);
-		emit(REX_SUBPD);
-		emitByte(0xc4 + 8 * instr.dst);
+		genAddressReg(instr.src, addressMask(instr), Rax);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFSUB_M_TMPL);
+			p[8] -= 8 * instr.dst;
+			p[10] += 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FSUB_M_TMPL);
+			p[10] += 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FSCAL_R(Instruction& instr) {
 		instr.dst %= 4;
-		emit(REX_XORPS);
-		emitByte(0xc7 + 8 * instr.dst);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFSCAL_R_TMPL);
+			p[2] -= 8 * instr.dst;
+			p[4] += 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FSCAL_R_TMPL);
+			p[3] += 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FMUL_R(Instruction& instr) {
 		instr.dst %= 4;
 		instr.src %= 4;
-		emit(REX_MULPD);
-		emitByte(0xe0 + instr.src + 8 * instr.dst);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFMUL_R_TMPL);
+			p[2] -= 8 * instr.dst;
+			p[4] += instr.src + 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FMUL_R_TMPL);
+			p[4] += instr.src + 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FMUL_M(Instruction& instr) {
 		instr.dst %= 4;
-		genAddressReg(instr);
-		emit(REX_CVTDQ2PD_XMM12);
-		emit(REX_ANDPS_XMM12);
-		emit(REX_MULPD);
-		emitByte(0xe4 + 8 * instr.dst);
-		emit(REX_MAXPD);
-		emitByte(0xe5 + 8 * instr.dst);
+		genAddressReg(instr.src, addressMask(instr), Rax);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFMUL_M_TMPL);
+			p[13] -= 8 * instr.dst;
+			p[15] += 8 * instr.dst;
+			p[18] -= 8 * instr.dst;
+			p[20] += 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FMUL_M_TMPL);
+			p[14] += 8 * instr.dst;
+			p[19] += 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FDIV_R(Instruction& instr) {
 		instr.dst %= 4;
 		instr.src %= 4;
-		emit(REX_DIVPD);
-		emitByte(0xe0 + instr.src + 8 * instr.dst);
-		emit(REX_MAXPD);
-		emitByte(0xe5 + 8 * instr.dst);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFDIV_R_TMPL);
+			p[2] -= 8 * instr.dst;
+			p[4] += instr.src + 8 * instr.dst;
+			p[7] -= 8 * instr.dst;
+			p[9] += 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FDIV_R_TMPL);
+			p[4] += instr.src + 8 * instr.dst;
+			p[9] += 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FDIV_M(Instruction& instr) {
 		instr.dst %= 4;
-		genAddressReg(instr);
-		emit(REX_CVTDQ2PD_XMM12);
-		emit(REX_ANDPS_XMM12);
-		emit(REX_DIVPD);
-		emitByte(0xe4 + 8 * instr.dst);
-		emit(REX_MAXPD);
-		emitByte(0xe5 + 8 * instr.dst);
+		genAddressReg(instr.src, addressMask(instr), Rax);
+		if (avx) {
+			uint8_t* p = emitTemplate(VFDIV_M_TMPL);
+			p[13] -= 8 * instr.dst;
+			p[15] += 8 * instr.dst;
+			p[18] -= 8 * instr.dst;
+			p[20] += 8 * instr.dst;
+		}
+		else {
+			uint8_t* p = emitTemplate(FDIV_M_TMPL);
+			p[14] += 8 * instr.dst;
+			p[19] += 8 * instr.dst;
+		}
 	}
 
 	void JitCompilerX86::h_FSQRT_R(Instruction& instr) {
 		instr.dst %= 4;
-		emit(SQRTPD);
-		emitByte(0xe4 + 9 * instr.dst);
+		uint8_t* p = emitTemplate(avx ? VFSQRT_R_TMPL : FSQRT_R_TMPL);
+		p[3] += 9 * instr.dst;
 	}
 
 	void JitCompilerX86::h_CFROUND(Instruction& instr) {
@@ -691,41 +1335,32 @@ namespace RandomX {
 	}
 
 	void JitCompilerX86::h_COND_R(Instruction& instr) {
-		emit(XOR_ECX_ECX);
-		emit(REX_CMP_R32I);
-		emitByte(0xf8 + instr.src);
-		emit32(instr.imm32);
-		emitByte(0x0f);
-		emitByte(condition(instr));
-		emitByte(0xc1);
-		emit(REX_ADD_RM);
-		emitByte(0xc1 + 8 * instr.dst);
+		uint8_t* p = emitTemplate(COND_R_TMPL);
+		p[4] += instr.src;
+		store32(p + 5, instr.imm32);
+		p[10] = condition(instr);
+		p[14] += 8 * instr.dst;
 	}
 
 	void JitCompilerX86::h_COND_M(Instruction& instr) {
 		emit(XOR_ECX_ECX);
-		genAddressReg(instr);
-		emit(REX_CMP_M32I);
-		emit32(instr.imm32);
-		emitByte(0x0f);
-		emitByte(condition(instr));
-		emitByte(0xc1);
-		emit(REX_ADD_RM);
-		emitByte(0xc1 + 8 * instr.dst);
+		genAddressReg(instr.src, addressMask(instr), Rax);
+		uint8_t* p = emitTemplate(COND_M_TMPL);
+		store32(p + 3, instr.imm32);
+		p[8] = condition(instr);
+		p[12] += 8 * instr.dst;
 	}
 
 	void JitCompilerX86::h_ISTORE(Instruction& instr) {
-		genAddressRegDst(instr);
-		emit(REX_MOV_MR);
-		emitByte(0x04 + 8 * instr.src);
-		emitByte(0x06);
+		genAddressReg(instr.dst, addressMask(instr), Rax);
+		uint8_t* p = emitTemplate(ISTORE_TMPL);
+		p[2] += 8 * instr.src;
 	}
 
 	void JitCompilerX86::h_FSTORE(Instruction& instr) {
-		genAddressRegDst(instr, true);
-		emit(MOVAPD);
-		emitByte(0x04 + 8 * instr.src);
-		emitByte(0x06);
+		genAddressReg(instr.dst, addressMask16(instr), Rax);
+		uint8_t* p = emitTemplate(FSTORE_TMPL);
+		p[3] += 8 * instr.src;
 	}
 
 	void JitCompilerX86::h_NOP(Instruction& instr) {
@@ -775,6 +1410,5 @@ namespace RandomX {
 		INST_HANDLE(NOP)
 	};
 
-
 #endif
 }
\ No newline at end of file
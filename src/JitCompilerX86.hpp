@@ -21,6 +21,9 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 
 #include "common.hpp"
 #include "Instruction.hpp"
+#include "InstructionScheduler.hpp"
+#include "codeLayout.hpp"
+#include "PerfJitLog.hpp"
 #include <cstring>
 #include <vector>
 
@@ -28,6 +31,7 @@ namespace RandomX {
 
 	class Program;
 	class JitCompilerX86;
+	class CodeRegion;
 
 	typedef void(JitCompilerX86::*InstructionGeneratorX86)(Instruction&);
 
@@ -35,26 +39,93 @@ namespace RandomX {
 
 	class JitCompilerX86 {
 	public:
-		JitCompilerX86();
+		JitCompilerX86(CodeRegion* codeRegion = nullptr, bool dualMapped = false);
+		~JitCompilerX86();
 		void generateProgram(Program&);
+		void generateBody(Program&);
 		ProgramFunc getProgramFunc() {
-			return (ProgramFunc)code;
+			return (ProgramFunc)exec;
+		}
+		bool isDualMapped() {
+			return dualMapped;
+		}
+		void setScheduling(bool enabled) {
+			scheduling = enabled;
+		}
+		//latencies used by the scheduler
+		void setInstructionCosts(const InstructionCosts& costs) {
+			scheduler.setCosts(costs);
+		}
+		void setRenaming(bool enabled) {
+			renaming = enabled;
+		}
+		void setPrefetching(bool enabled) {
+			prefetching = enabled;
+		}
+		//selects the VEX (AVX) and BMI2 encodings, both default to what the CPU supports
+		void setInstructionSets(bool avx, bool bmi2) {
+			this->avx = avx;
+			this->bmi2 = bmi2;
+		}
+		bool usesAvx() {
+			return avx;
+		}
+		bool usesBmi2() {
+			return bmi2;
+		}
+		//defaults to the profile detected for the CPU
+		void setCodeLayout(const CodeLayout& layout) {
+			this->layout = &layout;
+		}
+		const CodeLayout& getCodeLayout() {
+			return *layout;
 		}
 		uint8_t* getCode() {
 			return code;
 		}
+		//describes the generated code to 'perf', nullptr disables it
+		void setPerfLog(PerfJitLog* log);
 		size_t getCodeSize();
 	private:
 		static InstructionGeneratorX86 engine[256];
-		uint8_t* code;
+		uint8_t* code; //writable view of the code buffer
+		uint8_t* exec; //executable view, same as 'code' unless dual mapped
+		bool dualMapped;
+		CodeRegion* codeRegion; //owner of the code buffer, nullptr if allocated by the compiler
+		bool scheduling;
+		InstructionScheduler scheduler;
+		bool renaming;
+		uint8_t registerMap[RegistersCount]; //register that currently holds each program register
+		uint32_t laneSwapped; //bit mask of xmm registers with a deferred FSWAP_R
+		bool prefetching;
+		struct CachedAddress {
+			int reg; //-1 if the temporary doesn't hold an address
+			uint32_t mask;
+		} cachedAddress[2]; //scratchpad addresses held by rax and rcx
+		bool avx;
+		bool bmi2;
+		const CodeLayout* layout;
+		PerfJitLog* perfLog;
+		std::vector<CodeMarker> markers; //instruction markers of the last program for the perf log
 		int32_t codePos;
 
-		void genAddressReg(Instruction&, bool);
-		void genAddressRegDst(Instruction&, bool);
-		void genAddressImm(Instruction&);
-		void genSIB(int scale, int index, int base);
-
 		void generateCode(Instruction&);
+		void genAddressReg(int reg, uint32_t mask, int temp);
+		void invalidateAddresses(uint32_t temps);
+		void generateRenamed(Instruction&);
+		void emitLaneSwaps(uint32_t xmm);
+		void genLaneSwap(int xmm);
+		void restoreRegisters();
+		void genScratchpadPrefetch(uint32_t readReg0, uint32_t readReg1);
+		void alignBranch(int size);
+		void genNops(int count);
+		void addMarker(uint32_t line, const char* name) {
+			//code that emitted nothing (e.g. a renamed swap) has no address of its own
+			if (!markers.empty() && markers.back().offset == (uint32_t)codePos)
+				markers.back() = { (uint32_t)codePos, line, name };
+			else
+				markers.push_back({ (uint32_t)codePos, line, name });
+		}
 
 		void emitByte(uint8_t val) {
 			code[codePos] = val;
@@ -62,33 +133,34 @@ namespace RandomX {
 		}
 
 		void emit32(uint32_t val) {
-			code[codePos + 0] = val;
-			code[codePos + 1] = val >> 8;
-			code[codePos + 2] = val >> 16;
-			code[codePos + 3] = val >> 24;
+			store32(code + codePos, val);
 			codePos += 4;
 		}
 
 		void emit64(uint64_t val) {
-			code[codePos + 0] = val;
-			code[codePos + 1] = val >> 8;
-			code[codePos + 2] = val >> 16;
-			code[codePos + 3] = val >> 24;
-			code[codePos + 4] = val >> 32;
-			code[codePos + 5] = val >> 40;
-			code[codePos + 6] = val >> 48;
-			code[codePos + 7] = val >> 56;
+			memcpy(code + codePos, &val, sizeof(val));
 			codePos += 8;
 		}
 
 		template<size_t N>
 		void emit(const uint8_t (&src)[N]) {
-			for (unsigned i = 0; i < N; ++i) {
-				code[codePos + i] = src[i];
-			}
+			memcpy(code + codePos, src, N);
 			codePos += N;
 		}
 
+		//copies a pre-assembled instruction template and returns its address for patching
+		template<size_t N>
+		uint8_t* emitTemplate(const uint8_t (&tmpl)[N]) {
+			uint8_t* p = code + codePos;
+			memcpy(p, tmpl, N);
+			codePos += N;
+			return p;
+		}
+
+		static void store32(uint8_t* p, uint32_t val) {
+			memcpy(p, &val, sizeof(val));
+		}
+
 		void  h_IADD_R(Instruction&);
 		void  h_IADD_M(Instruction&);
 		void  h_IADD_RC(Instruction&);
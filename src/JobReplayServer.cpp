@@ -0,0 +1,120 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "JobReplayServer.hpp"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace RandomX {
+
+	JobReplayServer::JobReplayServer(std::vector<MiningJob> jobs, size_t queueCapacity) : jobs(std::move(jobs)), results(queueCapacity), current(0), stopped(false), accepted(0), stale(0), rejected(0) {
+		if (this->jobs.empty())
+			throw std::runtime_error("No jobs to replay");
+	}
+
+	static int hexValue(char c) {
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		return -1;
+	}
+
+	std::vector<MiningJob> JobReplayServer::loadJobs(const char* path) {
+		std::ifstream file(path);
+		if (!file)
+			throw std::runtime_error(std::string("Cannot open job file ") + path);
+		std::vector<MiningJob> jobs;
+		std::string line;
+		unsigned lineNumber = 0;
+		while (std::getline(file, line)) {
+			++lineNumber;
+			line = line.substr(0, line.find('#'));
+			std::istringstream fields(line);
+			std::string blob, target;
+			MiningJob job;
+			if (!(fields >> blob))
+				continue;
+			if (!(fields >> job.nonceOffset >> target) || blob.size() % 2 != 0)
+				throw std::runtime_error("Invalid job in line " + std::to_string(lineNumber));
+			for (size_t i = 0; i < blob.size(); i += 2) {
+				int hi = hexValue(blob[i]), lo = hexValue(blob[i + 1]);
+				if (hi < 0 || lo < 0)
+					throw std::runtime_error("Invalid blob in line " + std::to_string(lineNumber));
+				job.blob.push_back(16 * hi + lo);
+			}
+			if ((uint64_t)job.nonceOffset + sizeof(uint32_t) > job.blob.size())
+				throw std::runtime_error("Nonce offset out of range in line " + std::to_string(lineNumber));
+			job.target = std::stoull(target, nullptr, 16);
+			job.id = jobs.size() + 1;
+			jobs.push_back(std::move(job));
+		}
+		return jobs;
+	}
+
+	std::vector<MiningJob> JobReplayServer::generateJobs(const uint8_t* blob, size_t size, uint32_t nonceOffset, uint64_t target, unsigned count) {
+		std::vector<MiningJob> jobs(count);
+		for (unsigned i = 0; i < count; ++i) {
+			MiningJob& job = jobs[i];
+			job.id = i + 1;
+			job.blob.assign(blob, blob + size);
+			for (unsigned j = 0; j < sizeof(job.id); ++j)
+				job.blob[size - 4 + j] ^= job.id >> (8 * j);
+			job.nonceOffset = nonceOffset;
+			job.target = target;
+		}
+		return jobs;
+	}
+
+	void JobReplayServer::run(unsigned interval) {
+		for (size_t i = 0; i < jobs.size(); ++i) {
+			if (i > 0) {
+				current.store(i, std::memory_order_release);
+				token.cancel();
+			}
+			auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+			while (std::chrono::steady_clock::now() < end) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				collectShares();
+			}
+		}
+		stopped.store(true, std::memory_order_release);
+		token.cancel();
+	}
+
+	void JobReplayServer::collectShares() {
+		const MiningJob& job = jobs[current.load(std::memory_order_relaxed)];
+		Share share;
+		while (results.pop(share)) {
+			if (share.jobId != job.id)
+				stale++;
+			else if (meetsTarget(share.hash, job.target))
+				accepted++;
+			else
+				rejected++;
+		}
+	}
+
+}
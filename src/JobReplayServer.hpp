@@ -0,0 +1,84 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "MiningJob.hpp"
+#include "ResultQueue.hpp"
+#include "CancellationToken.hpp"
+
+namespace RandomX {
+
+	/*
+		Local stand-in for a pool connection. It replays a list of jobs, each for
+		a fixed time, and collects the shares submitted by the hashing threads.
+		A new job is published by storing its index and cancelling the token,
+		so the hashing threads switch within one program execution.
+	*/
+	class JobReplayServer {
+	public:
+		JobReplayServer(std::vector<MiningJob> jobs, size_t queueCapacity = 1024);
+		//one job per line: blob (hex), nonce offset, target (hex); '#' starts a comment
+		static std::vector<MiningJob> loadJobs(const char* path);
+		//jobs that differ in the last 4 bytes of the blob, like a new merkle root
+		static std::vector<MiningJob> generateJobs(const uint8_t* blob, size_t size, uint32_t nonceOffset, uint64_t target, unsigned count);
+		//returns the current job, 'generation' receives the token snapshot it belongs to
+		const MiningJob& getJob(uint32_t& generation) const {
+			generation = token.snapshot();
+			return jobs[current.load(std::memory_order_acquire)];
+		}
+		const CancellationToken& getToken() const {
+			return token;
+		}
+		bool isStopped() const {
+			return stopped.load(std::memory_order_acquire);
+		}
+		//returns false if the share was dropped because the queue is full
+		bool submit(const Share& share) {
+			return results.push(share);
+		}
+		//publishes the jobs one after another for 'interval' milliseconds each, then stops
+		void run(unsigned interval);
+		//checks the shares in the queue
+		void collectShares();
+		size_t getJobCount() const {
+			return jobs.size();
+		}
+		uint64_t getAccepted() const {
+			return accepted;
+		}
+		uint64_t getStale() const {
+			return stale;
+		}
+		uint64_t getRejected() const {
+			return rejected;
+		}
+	private:
+		std::vector<MiningJob> jobs;
+		ResultQueue results;
+		CancellationToken token;
+		std::atomic<size_t> current;
+		std::atomic<bool> stopped;
+		uint64_t accepted, stale, rejected;
+	};
+
+}
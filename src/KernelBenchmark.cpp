@@ -0,0 +1,321 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Times the kernels of RandomX one at a time, using the same objects as the
+	miner. Every result is printed as one JSON object per line; the same lines
+	form the baseline file that later runs are compared with.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Stopwatch.hpp"
+#include "blake2/blake2.h"
+#include "common.hpp"
+#include "Cache.hpp"
+#include "dataset.hpp"
+#include "hashAes1Rx4.hpp"
+#include "squareHash.h"
+#include "Program.hpp"
+#include "JitCompilerX86.hpp"
+#include "CompiledVirtualMachine.hpp"
+#include "InterpretedVirtualMachine.hpp"
+#include "blockTemplate.hpp"
+
+struct KernelResult {
+	std::string name;
+	std::string unit;
+	double median; //ns per unit
+	double min;
+	double baseline; //0 if the kernel isn't in the baseline
+};
+
+struct Options {
+	std::string filter;
+	std::string baselinePath;
+	bool help;
+	bool save;
+	int reps;
+	double threshold; //percent
+};
+
+constexpr int ProgramCount = 64;
+
+static volatile uint64_t sink; //keeps the results of the timed kernels alive
+
+/*
+	Runs 'rep' the given number of times. Each call returns the nanoseconds
+	it spent in the kernel, so that per-run setup can be excluded.
+*/
+static KernelResult measure(const char* name, const char* unit, int units, int reps, std::function<double()> rep) {
+	rep(); //warm-up
+	std::vector<double> samples;
+	for (int i = 0; i < reps; ++i)
+		samples.push_back(rep() / units);
+	std::sort(samples.begin(), samples.end());
+	return { name, unit, samples[samples.size() / 2], samples[0], 0 };
+}
+
+template<typename F>
+static double timed(F kernel) {
+	Stopwatch sw(true);
+	kernel();
+	return sw.getElapsed() * 1e9;
+}
+
+static void printResult(std::ostream& os, const KernelResult& r) {
+	os << std::fixed << std::setprecision(1);
+	os << "{\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"median_ns\": " << r.median << ", \"min_ns\": " << r.min;
+	if (r.baseline > 0)
+		os << ", \"baseline_ns\": " << r.baseline << ", \"change_pct\": " << 100 * (r.median / r.baseline - 1);
+	os << "}" << std::endl;
+}
+
+//reads the lines written by printResult
+static bool readBaseline(const std::string& path, std::vector<KernelResult>& results) {
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+	std::string line;
+	const std::string nameKey = "\"name\": \"", medianKey = "\"median_ns\": ";
+	while (std::getline(file, line)) {
+		size_t name = line.find(nameKey), median = line.find(medianKey);
+		if (name == std::string::npos || median == std::string::npos)
+			continue;
+		name += nameKey.size();
+		std::string kernel = line.substr(name, line.find('"', name) - name);
+		double value = std::stod(line.substr(median + medianKey.size()));
+		for (KernelResult& r : results) {
+			if (r.name == kernel)
+				r.baseline = value;
+		}
+	}
+	return true;
+}
+
+static void readOptions(int argc, char** argv, Options& options) {
+	options.help = false;
+	options.save = false;
+	options.reps = 7;
+	options.threshold = 5;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--filter" && hasValue)
+			options.filter = argv[++i];
+		else if (arg == "--baseline" && hasValue)
+			options.baselinePath = argv[++i];
+		else if (arg == "--help")
+			options.help = true;
+		else if (arg == "--save")
+			options.save = true;
+		else if (arg == "--reps" && hasValue)
+			options.reps = std::max(1, atoi(argv[++i]));
+		else if (arg == "--threshold" && hasValue)
+			options.threshold = atof(argv[++i]);
+		else
+			throw std::runtime_error("Unknown option " + arg);
+	}
+}
+
+static void printUsage(const char* executable) {
+	std::cout << "Usage: " << executable << " [OPTIONS]" << std::endl;
+	std::cout << "  --filter S      run only the kernels whose name contains S" << std::endl;
+	std::cout << "  --reps N        timed runs per kernel, the median is reported (default: 7)" << std::endl;
+	std::cout << "  --baseline F    compare with the results in F, or create F if it doesn't exist" << std::endl;
+	std::cout << "  --save          overwrite the baseline with the results of this run" << std::endl;
+	std::cout << "  --threshold P   slowdown in percent reported as a regression (default: 5)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	try {
+		readOptions(argc, argv, options);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (options.help) {
+		printUsage(argv[0]);
+		return 0;
+	}
+	int reps = options.reps;
+	auto selected = [&](const char* name) {
+		return strstr(name, options.filter.c_str()) != nullptr;
+	};
+	std::vector<KernelResult> results;
+	auto run = [&](const KernelResult& r) {
+		results.push_back(r);
+		std::cerr << r.name << " done" << std::endl;
+	};
+
+	try {
+		alignas(16) uint64_t hash[8];
+		blake2b(hash, sizeof(hash), blockTemplate__, sizeof(blockTemplate__), nullptr, 0);
+		std::vector<uint8_t> scratchpad(RandomX::ScratchpadSize);
+
+		//the cache is needed by initBlock and the interpreter
+		RandomX::Cache* cache = nullptr;
+		bool needCache = selected("cache_initialize") || selected("init_block") || selected("interpreter_execute");
+		if (needCache)
+			cache = RandomX::Cache::alloc(false);
+		if (selected("cache_initialize")) {
+			run(measure("cache_initialize", "cache", 1, std::min(reps, 3), [&] {
+				return timed([&] { cache->initialize<false>(hash, RandomX::SeedSize); });
+			}));
+		}
+		else if (needCache) {
+			cache->initialize<false>(hash, RandomX::SeedSize);
+		}
+		if (selected("init_block")) {
+			constexpr int blocks = 16384;
+			alignas(64) uint8_t block[RandomX::CacheLineSize];
+			run(measure("init_block", "block", blocks, reps, [&] {
+				return timed([&] {
+					for (uint32_t i = 0; i < blocks; ++i)
+						RandomX::initBlock(cache->getCache(), block, i * 257, cache->getKeys());
+				});
+			}));
+			sink = block[0];
+		}
+		if (selected("fill_aes_1rx4_soft")) {
+			run(measure("fill_aes_1rx4_soft", "scratchpad", 1, reps, [&] {
+				return timed([&] { fillAes1Rx4<true>(hash, RandomX::ScratchpadSize, scratchpad.data()); });
+			}));
+		}
+		if (selected("fill_aes_1rx4_hard")) {
+			run(measure("fill_aes_1rx4_hard", "scratchpad", 1, reps, [&] {
+				return timed([&] { fillAes1Rx4<false>(hash, RandomX::ScratchpadSize, scratchpad.data()); });
+			}));
+		}
+		if (selected("hash_aes_1rx4_soft")) {
+			run(measure("hash_aes_1rx4_soft", "scratchpad", 1, reps, [&] {
+				return timed([&] { hashAes1Rx4<true>(scratchpad.data(), RandomX::ScratchpadSize, hash); });
+			}));
+		}
+		if (selected("hash_aes_1rx4_hard")) {
+			run(measure("hash_aes_1rx4_hard", "scratchpad", 1, reps, [&] {
+				return timed([&] { hashAes1Rx4<false>(scratchpad.data(), RandomX::ScratchpadSize, hash); });
+			}));
+		}
+		if (selected("blake2b")) {
+			constexpr int count = 100000;
+			run(measure("blake2b", "hash", count, reps, [&] {
+				return timed([&] {
+					for (int i = 0; i < count; ++i)
+						blake2b(hash, sizeof(hash), blockTemplate__, sizeof(blockTemplate__), nullptr, 0);
+				});
+			}));
+		}
+		if (selected("square_hash")) {
+			constexpr int count = 1000000;
+			uint64_t x = hash[0];
+			//each call depends on the previous one, so this is the latency of squareHash
+			run(measure("square_hash", "call", count, reps, [&] {
+				return timed([&] {
+					for (int i = 0; i < count; ++i)
+						x = squareHash(x);
+				});
+			}));
+			sink = x;
+		}
+
+		std::vector<RandomX::Program> programs(ProgramCount);
+		for (int i = 0; i < ProgramCount; ++i) {
+			fillAes1Rx4<false>(hash, sizeof(RandomX::Program), &programs[i]);
+		}
+		if (selected("jit_generate")) {
+			RandomX::JitCompilerX86 compiler;
+			run(measure("jit_generate", "program", ProgramCount, reps, [&] {
+				return timed([&] {
+					for (int i = 0; i < ProgramCount; ++i)
+						compiler.generateProgram(programs[i]);
+				});
+			}));
+		}
+		auto executePrograms = [&](RandomX::VirtualMachine* vm) {
+			double ns = 0;
+			vm->setScratchpad(scratchpad.data());
+			for (int i = 0; i < ProgramCount / 8; ++i) {
+				*vm->getProgramBuffer() = programs[i];
+				vm->initialize();
+				ns += timed([&] { vm->execute(); });
+			}
+			return ns;
+		};
+		if (selected("compiled_execute")) {
+			/*
+				The dataset is allocated but not initialized: its pages are not backed,
+				so every dataset read hits the same zero page and this measures the
+				program without DRAM latency. The miner shows the end-to-end rate.
+			*/
+			RandomX::dataset_t dataset;
+			PageSize pageSize;
+			RandomX::datasetAlloc(dataset, false, pageSize);
+			RandomX::CompiledVirtualMachine* vm = new RandomX::CompiledVirtualMachine();
+			vm->setDataset(dataset);
+			run(measure("compiled_execute", "program", ProgramCount / 8, reps, [&] { return executePrograms(vm); }));
+			delete vm;
+			_mm_free(dataset.dataset);
+		}
+		if (selected("interpreter_execute")) {
+			RandomX::dataset_t dataset;
+			dataset.cache = cache;
+			RandomX::InterpretedVirtualMachine* vm = new RandomX::InterpretedVirtualMachine(false, false);
+			vm->setDataset(dataset);
+			run(measure("interpreter_execute", "program", ProgramCount / 8, std::min(reps, 3), [&] { return executePrograms(vm); }));
+			delete vm;
+		}
+		if (cache != nullptr)
+			RandomX::Cache::dealloc(cache);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	bool haveBaseline = !options.baselinePath.empty() && !options.save && readBaseline(options.baselinePath, results);
+	int regressions = 0;
+	for (const KernelResult& r : results) {
+		printResult(std::cout, r);
+		if (r.baseline > 0 && r.median > r.baseline * (1 + options.threshold / 100)) {
+			std::cerr << "REGRESSION: " << r.name << " " << std::setprecision(1) << 100 * (r.median / r.baseline - 1) << "% slower than the baseline" << std::endl;
+			regressions++;
+		}
+	}
+	if (!options.baselinePath.empty() && !haveBaseline) {
+		std::ofstream file(options.baselinePath);
+		for (KernelResult r : results) {
+			r.baseline = 0;
+			printResult(file, r);
+		}
+		std::cerr << "Baseline saved to " << options.baselinePath << std::endl;
+	}
+	return regressions > 0 ? 2 : 0;
+}
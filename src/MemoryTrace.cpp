@@ -0,0 +1,75 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <stdexcept>
+#include "MemoryTrace.hpp"
+
+namespace RandomX {
+
+	static const char Magic[8] = { 'R', 'X', 'M', 'E', 'M', 'T', 'R', 'C' };
+
+	//the sizes of the scratchpad levels the trace was recorded with
+	struct TraceHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t scratchpadSize;
+		uint32_t scratchpadL1Size;
+		uint32_t scratchpadL2Size;
+	};
+
+	MemoryTrace::~MemoryTrace() {
+		flush();
+	}
+
+	void MemoryTrace::load(const std::string& path, std::vector<uint32_t>& records) {
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if (!in)
+			throw std::runtime_error("Cannot open memory trace " + path);
+		std::streamoff size = in.tellg();
+		in.seekg(0);
+		TraceHeader header;
+		if (!in.read((char*)&header, sizeof(header)) || memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+			throw std::runtime_error(path + " is not a memory trace");
+		if (header.version != Version || header.scratchpadSize != ScratchpadSize || header.scratchpadL1Size != ScratchpadL1 * sizeof(int_reg_t) || header.scratchpadL2Size != ScratchpadL2 * sizeof(int_reg_t))
+			throw std::runtime_error(path + " was written by an incompatible version");
+		records.resize((size - sizeof(header)) / sizeof(uint32_t));
+		if (!in.read((char*)records.data(), records.size() * sizeof(uint32_t)))
+			throw std::runtime_error("Cannot read memory trace " + path);
+	}
+
+	void MemoryTrace::create(const std::string& path) {
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			throw std::runtime_error("Cannot create memory trace " + path);
+		TraceHeader header;
+		memcpy(header.magic, Magic, sizeof(Magic));
+		header.version = Version;
+		header.scratchpadSize = ScratchpadSize;
+		header.scratchpadL1Size = ScratchpadL1 * sizeof(int_reg_t);
+		header.scratchpadL2Size = ScratchpadL2 * sizeof(int_reg_t);
+		file.write((const char*)&header, sizeof(header));
+	}
+
+	void MemoryTrace::flush() {
+		if (count > 0 && file.is_open())
+			file.write((const char*)buffer, count * sizeof(uint32_t));
+		count = 0;
+	}
+}
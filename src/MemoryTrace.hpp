@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+namespace RandomX {
+
+	//kind of a trace record, stored in its top 4 bits
+	enum MemoryAccess : uint32_t {
+		AccessL1Read, //scratchpad byte offset read by an instruction, by address mask
+		AccessL2Read,
+		AccessL3Read,
+		AccessL1Write,
+		AccessL2Write,
+		AccessL3Write,
+		AccessLineRead, //64-byte line read by the loop at the start of an iteration
+		AccessLineWrite, //64-byte line written by the loop at the end of an iteration
+		AccessDataset, //dataset line number
+		AccessHashStart, //the scratchpad was filled for the next hash
+		AccessProgramStart,
+		AccessCount
+	};
+
+	constexpr int MemoryAccessShift = 28;
+	constexpr uint32_t MemoryAccessPayloadMask = (1U << MemoryAccessShift) - 1;
+
+	static_assert(ScratchpadSize - 1 <= MemoryAccessPayloadMask, "Scratchpad offsets don't fit into a trace record");
+	static_assert(DatasetSize / CacheLineSize - 1 <= MemoryAccessPayloadMask, "Dataset lines don't fit into a trace record");
+
+	/*
+		Binary trace of the scratchpad and dataset accesses of a VM, written with
+		--traceMemory. After the header, every access is one uint32 record: the
+		kind (MemoryAccess) in the top 4 bits and the scratchpad byte offset or
+		the dataset line number in the low 28 bits. Records are buffered and
+		stored in the byte order of the host.
+	*/
+	class MemoryTrace {
+	public:
+		static constexpr uint32_t Version = 1;
+
+		MemoryTrace() : count(0) {}
+		~MemoryTrace();
+		//reads all records of a trace file
+		static void load(const std::string& path, std::vector<uint32_t>& records);
+		void create(const std::string& path);
+		void record(MemoryAccess access, uint32_t payload) {
+			buffer[count++] = ((uint32_t)access << MemoryAccessShift) | payload;
+			if (count == BufferSize)
+				flush();
+		}
+		//the address mask of the instruction gives the L1, L2 or L3 class of the access
+		void scratchpadRead(uint32_t offset, uint32_t mask) {
+			record((MemoryAccess)(AccessL1Read + level(mask)), offset);
+		}
+		void scratchpadWrite(uint32_t offset, uint32_t mask) {
+			record((MemoryAccess)(AccessL1Write + level(mask)), offset);
+		}
+		void flush();
+		//false if the file couldn't be written
+		bool good() const {
+			return (bool)file;
+		}
+	private:
+		static constexpr size_t BufferSize = 1 << 16;
+		static int level(uint32_t mask) {
+			return mask == ScratchpadL1Mask ? 0 : (mask == ScratchpadL2Mask ? 1 : 2);
+		}
+		uint32_t buffer[BufferSize];
+		size_t count;
+		std::ofstream file;
+	};
+
+}
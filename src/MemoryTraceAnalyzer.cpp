@@ -0,0 +1,302 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Analyzes a memory trace written by 'randomx --traceMemory'. It reports the
+	LRU reuse distances of the scratchpad lines, the number of pages each
+	program touches and the number of TLB entries needed for a given hit rate,
+	for 4 KiB, 2 MiB and 1 GiB pages.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "common.hpp"
+#include "MemoryTrace.hpp"
+
+//LRU stack distance: the number of distinct keys accessed since the previous access to the same key
+class StackDistance {
+public:
+	explicit StackDistance(size_t accesses) : tree(accesses + 1, 0), time(0) {}
+	//-1 for the first access to a key
+	int64_t access(uint64_t key) {
+		++time;
+		int64_t distance = -1;
+		auto it = last.find(key);
+		if (it != last.end()) {
+			distance = prefix(time - 1) - prefix(it->second);
+			add(it->second, -1);
+			it->second = time;
+		}
+		else {
+			last.emplace(key, time);
+		}
+		add(time, 1);
+		return distance;
+	}
+private:
+	//Fenwick tree with a 1 at the time of the latest access to each key
+	void add(size_t i, int32_t value) {
+		for (; i < tree.size(); i += i & (0 - i))
+			tree[i] += value;
+	}
+	int64_t prefix(size_t i) const {
+		int64_t sum = 0;
+		for (; i > 0; i -= i & (0 - i))
+			sum += tree[i];
+		return sum;
+	}
+	std::vector<int32_t> tree;
+	std::unordered_map<uint64_t, size_t> last;
+	size_t time;
+};
+
+class Histogram {
+public:
+	explicit Histogram(size_t limit) : counts(limit + 1, 0), cold(0), total(0) {}
+	void add(int64_t distance) {
+		total++;
+		if (distance < 0)
+			cold++;
+		else
+			counts[std::min((size_t)distance, counts.size() - 1)]++;
+	}
+	//share of the accesses that hit a fully associative LRU structure of 'entries' entries
+	double hitRate(size_t entries) const {
+		uint64_t hits = 0;
+		for (size_t d = 0; d < std::min(entries, counts.size() - 1); ++d)
+			hits += counts[d];
+		return total > 0 ? (double)hits / total : 0;
+	}
+	//smallest number of entries with at least the given hit rate, 0 if it's beyond the limit
+	size_t entriesFor(double rate) const {
+		uint64_t hits = 0;
+		for (size_t d = 0; d < counts.size() - 1; ++d) {
+			hits += counts[d];
+			if (hits >= rate * total)
+				return d + 1;
+		}
+		return 0;
+	}
+	uint64_t getCold() const {
+		return cold;
+	}
+	uint64_t getTotal() const {
+		return total;
+	}
+private:
+	std::vector<uint64_t> counts;
+	uint64_t cold, total;
+};
+
+struct TracePage {
+	const char* name;
+	uint64_t size;
+};
+
+static const TracePage pageSizes[] = {
+	{ "4 KiB", 4096 },
+	{ "2 MiB", 2 * 1024 * 1024 },
+	{ "1 GiB", 1024 * 1024 * 1024 },
+};
+
+static const char* accessNames[RandomX::AccessCount] = {
+	"L1 read", "L2 read", "L3 read", "L1 write", "L2 write", "L3 write", "line read", "line write", "dataset", "hash", "program",
+};
+
+static RandomX::MemoryAccess getAccess(uint32_t record) {
+	return (RandomX::MemoryAccess)(record >> RandomX::MemoryAccessShift);
+}
+
+static bool isScratchpad(RandomX::MemoryAccess access) {
+	return access <= RandomX::AccessLineWrite;
+}
+
+//scratchpad and dataset pages get separate keys
+static uint64_t pageKey(uint32_t record, uint64_t pageSize) {
+	uint64_t payload = record & RandomX::MemoryAccessPayloadMask;
+	if (getAccess(record) == RandomX::AccessDataset)
+		return (1ULL << 63) | (payload * RandomX::CacheLineSize / pageSize);
+	return payload / pageSize;
+}
+
+static std::string formatSize(double bytes) {
+	const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+	int unit = 0;
+	while (bytes >= 1024 && unit < 4) {
+		bytes /= 1024;
+		unit++;
+	}
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(bytes < 10 && unit > 0 ? 1 : 0) << bytes << " " << units[unit];
+	return ss.str();
+}
+
+static void printSummary(const std::vector<uint32_t>& records) {
+	uint64_t counts[RandomX::AccessCount] = { 0 };
+	for (uint32_t record : records)
+		counts[getAccess(record)]++;
+	uint64_t iterations = counts[RandomX::AccessDataset];
+	std::cout << "Trace: " << records.size() << " records, " << counts[RandomX::AccessHashStart] << " hashes, ";
+	std::cout << counts[RandomX::AccessProgramStart] << " programs, " << iterations << " iterations" << std::endl;
+	if (iterations == 0)
+		return;
+	std::cout << std::left << std::setw(14) << "access" << std::right << std::setw(14) << "count" << std::setw(14) << "per iter" << std::endl;
+	for (uint32_t i = 0; i < RandomX::AccessHashStart; ++i) {
+		std::cout << std::left << std::setw(14) << accessNames[i] << std::right << std::setw(14) << counts[i];
+		std::cout << std::setw(14) << std::fixed << std::setprecision(2) << (double)counts[i] / iterations << std::endl;
+	}
+}
+
+/*
+	The scratchpad is rewritten by fillAes1Rx4 for every hash, so the line
+	distances restart at each hash and the first access to a line is counted
+	separately.
+*/
+static void printLineReuse(const std::vector<uint32_t>& records) {
+	const size_t lines = RandomX::ScratchpadSize / RandomX::CacheLineSize;
+	const size_t capacities[] = { 16 * 1024, 32 * 1024, 256 * 1024, 1024 * 1024, 2 * 1024 * 1024 };
+	std::vector<Histogram> histograms(RandomX::AccessDataset, Histogram(lines));
+	size_t begin = 0;
+	while (begin < records.size()) {
+		size_t end = begin + 1;
+		while (end < records.size() && getAccess(records[end]) != RandomX::AccessHashStart)
+			end++;
+		StackDistance distance(end - begin);
+		for (size_t i = begin; i < end; ++i) {
+			RandomX::MemoryAccess access = getAccess(records[i]);
+			if (isScratchpad(access))
+				histograms[access].add(distance.access((records[i] & RandomX::MemoryAccessPayloadMask) / RandomX::CacheLineSize));
+		}
+		begin = end;
+	}
+	std::cout << "Scratchpad line reuse: share of accesses that hit an LRU cache of the given size" << std::endl;
+	std::cout << std::left << std::setw(14) << "access";
+	for (size_t capacity : capacities)
+		std::cout << std::right << std::setw(10) << formatSize(capacity);
+	std::cout << std::setw(10) << "first" << std::endl;
+	for (uint32_t i = 0; i < RandomX::AccessDataset; ++i) {
+		const Histogram& h = histograms[i];
+		if (h.getTotal() == 0)
+			continue;
+		std::cout << std::left << std::setw(14) << accessNames[i] << std::right << std::fixed << std::setprecision(1);
+		for (size_t capacity : capacities)
+			std::cout << std::setw(9) << 100 * h.hitRate(capacity / RandomX::CacheLineSize) << "%";
+		std::cout << std::setw(9) << 100.0 * h.getCold() / h.getTotal() << "%" << std::endl;
+	}
+}
+
+static void printPageSpread(const std::vector<uint32_t>& records) {
+	std::cout << "Page spread: distinct pages per program and in the whole trace" << std::endl;
+	std::cout << std::left << std::setw(10) << "page" << std::right << std::setw(18) << "scratchpad/prog" << std::setw(16) << "dataset/prog";
+	std::cout << std::setw(18) << "scratchpad total" << std::setw(16) << "dataset total" << std::endl;
+	for (const TracePage& page : pageSizes) {
+		std::unordered_set<uint64_t> program[2], total[2];
+		uint64_t programs = 0, sums[2] = { 0, 0 };
+		auto endProgram = [&]() {
+			if (!program[0].empty() || !program[1].empty()) {
+				programs++;
+				for (int k = 0; k < 2; ++k) {
+					sums[k] += program[k].size();
+					program[k].clear();
+				}
+			}
+		};
+		for (uint32_t record : records) {
+			RandomX::MemoryAccess access = getAccess(record);
+			if (access == RandomX::AccessProgramStart) {
+				endProgram();
+			}
+			else if (access <= RandomX::AccessDataset) {
+				int k = access == RandomX::AccessDataset ? 1 : 0;
+				uint64_t key = pageKey(record, page.size);
+				program[k].insert(key);
+				total[k].insert(key);
+			}
+		}
+		endProgram();
+		std::cout << std::left << std::setw(10) << page.name << std::right << std::fixed << std::setprecision(1);
+		std::cout << std::setw(18) << (programs > 0 ? (double)sums[0] / programs : 0) << std::setw(16) << (programs > 0 ? (double)sums[1] / programs : 0);
+		std::cout << std::setw(18) << total[0].size() << std::setw(16) << total[1].size() << std::endl;
+	}
+}
+
+static void printTlbReach(const std::vector<uint32_t>& records) {
+	const double rates[] = { 0.9, 0.99, 0.999 };
+	const size_t limit = 1 << 20;
+	std::cout << "TLB reach: entries of a fully associative LRU TLB needed for the hit rate" << std::endl;
+	std::cout << std::left << std::setw(10) << "page" << std::setw(12) << "accesses";
+	for (double rate : rates) {
+		std::ostringstream ss;
+		ss << 100 * rate << "% hits";
+		std::cout << std::right << std::setw(21) << ss.str();
+	}
+	std::cout << std::endl;
+	for (const TracePage& page : pageSizes) {
+		for (int datasetOnly = 0; datasetOnly < 2; ++datasetOnly) {
+			Histogram h(limit);
+			StackDistance distance(records.size());
+			for (uint32_t record : records) {
+				RandomX::MemoryAccess access = getAccess(record);
+				if (access == RandomX::AccessDataset || (!datasetOnly && isScratchpad(access)))
+					h.add(distance.access(pageKey(record, page.size)));
+			}
+			std::cout << std::left << std::setw(10) << page.name << std::setw(12) << (datasetOnly ? "dataset" : "all");
+			for (double rate : rates) {
+				size_t entries = h.entriesFor(rate);
+				std::ostringstream ss;
+				if (entries == 0)
+					ss << "-";
+				else
+					ss << entries << " (" << formatSize((double)entries * page.size) << ")";
+				std::cout << std::right << std::setw(21) << ss.str();
+			}
+			std::cout << std::endl;
+		}
+	}
+	std::cout << "'-': more than " << limit << " entries or too many first accesses" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 2 || std::string(argv[1]) == "--help") {
+		std::cout << "Usage: " << argv[0] << " TRACE" << std::endl;
+		std::cout << "  TRACE is a file written by 'randomx --traceMemory TRACE'" << std::endl;
+		return argc == 2 ? 0 : 1;
+	}
+	try {
+		std::vector<uint32_t> records;
+		RandomX::MemoryTrace::load(argv[1], records);
+		printSummary(records);
+		printLineReuse(records);
+		printPageSpread(records);
+		printTlbReach(records);
+	}
+	catch (std::exception& e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
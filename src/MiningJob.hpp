@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace RandomX {
+
+	//a hashing blob with the position of the 32-bit nonce and the share target
+	struct MiningJob {
+		uint32_t id;
+		std::vector<uint8_t> blob;
+		uint32_t nonceOffset;
+		uint64_t target; //a hash is a share if its last 64 bits are below the target
+
+		void setNonce(uint8_t* copy, uint32_t nonce) const {
+			memcpy(copy + nonceOffset, &nonce, sizeof(nonce));
+		}
+	};
+
+	//compares the last 64 bits of the hash (little endian) with the target
+	inline bool meetsTarget(const uint64_t* hash, uint64_t target) {
+		return hash[3] < target;
+	}
+
+	inline uint64_t difficultyToTarget(uint64_t difficulty) {
+		return difficulty <= 1 ? UINT64_MAX : UINT64_MAX / difficulty;
+	}
+
+	/*
+		Nonces [start, end). In the job replay mode, the nonce space of a job is
+		split into one contiguous range per thread when the job starts, so
+		hashing threads don't share a nonce counter while they hash the job.
+	*/
+	struct NonceRange {
+		uint64_t start, end;
+
+		static NonceRange forThread(unsigned thread, unsigned threadCount, uint64_t first, uint64_t count) {
+			return { first + count * thread / threadCount, first + count * (thread + 1) / threadCount };
+		}
+	};
+
+	constexpr uint64_t NonceChunkSize = 64;
+
+	/*
+		Hands out a fixed number of nonces to the hashing threads in chunks, so
+		that a thread that hashes more slowly (e.g. one that shares its core with
+		an SMT sibling) takes fewer chunks instead of finishing last. Threads
+		touch the shared counter once per chunk. Chunks are at most NonceChunkSize
+		nonces and small enough that each thread gets about 8 of them.
+	*/
+	class NonceCounter {
+	public:
+		NonceCounter(uint64_t first, uint64_t count, unsigned threadCount) : next(first), end(first + count) {
+			chunkSize = std::max<uint64_t>(1, std::min(NonceChunkSize, count / (8 * threadCount)));
+		}
+		//the next chunk of nonces, empty when all of them have been handed out
+		NonceRange take() {
+			uint64_t start = next.fetch_add(chunkSize, std::memory_order_relaxed);
+			if (start >= end)
+				return { end, end };
+			return { start, std::min(start + chunkSize, end) };
+		}
+	private:
+		std::atomic<uint64_t> next;
+		uint64_t end;
+		uint64_t chunkSize;
+	};
+
+}
@@ -0,0 +1,205 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "PerfCounters.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace RandomX {
+
+	static const char* eventNames[CounterEventCount] = {
+		"cycles",
+		"instructions",
+		"branch mispredictions",
+		"L1D misses",
+		"L2 misses (LLC references)",
+		"LLC misses",
+		"dTLB misses",
+		"iTLB misses",
+	};
+
+	PerfCounters::PerfCounters() : minCoverage(1.0) {
+		for (int g = 0; g < GroupCount; ++g)
+			leaders[g] = -1;
+		for (int i = 0; i < CounterEventCount; ++i) {
+			fds[i] = -1;
+			available[i] = false;
+			values[i] = 0;
+		}
+	}
+
+	PerfCounters::~PerfCounters() {
+		close();
+	}
+
+	void PerfCounters::merge(const PerfCounters& other) {
+		for (int i = 0; i < CounterEventCount; ++i) {
+			available[i] = available[i] || other.available[i];
+			values[i] += other.values[i];
+		}
+		if (other.minCoverage < minCoverage)
+			minCoverage = other.minCoverage;
+		if (error.empty())
+			error = other.error;
+	}
+
+	void PerfCounters::printReport(std::ostream& os, uint64_t hashCount) const {
+		bool any = false;
+		for (int i = 0; i < CounterEventCount; ++i)
+			any = any || available[i];
+		if (!any) {
+			os << "Hardware counters unavailable" << (error.empty() ? "" : ": ") << error << std::endl;
+			return;
+		}
+		if (hashCount == 0) {
+			os << "Hardware counters: no hashes were calculated" << std::endl;
+			return;
+		}
+		os << "Hardware counters per hash (whole hashing thread):" << std::endl;
+		for (int i = 0; i < CounterEventCount; ++i) {
+			os << "  " << std::left << std::setw(28) << eventNames[i] << std::right;
+			if (available[i])
+				os << std::fixed << std::setprecision(0) << std::setw(14) << values[i] / hashCount;
+			else
+				os << std::setw(14) << "n/a";
+			if (i == CounterInstructions && available[CounterCycles] && available[CounterInstructions] && values[CounterCycles] > 0)
+				os << "  IPC " << std::setprecision(2) << values[CounterInstructions] / values[CounterCycles];
+			os << std::endl;
+		}
+		os.unsetf(std::ios::floatfield);
+		if (minCoverage < 1.0)
+			os << "  (multiplexed, scaled from " << std::setprecision(3) << minCoverage * 100 << "% of the time)" << std::endl;
+	}
+
+#ifndef __linux__
+	bool PerfCounters::start() {
+		error = "perf_event_open is only supported on Linux";
+		return false;
+	}
+
+	void PerfCounters::stop() {
+
+	}
+
+	void PerfCounters::close() {
+
+	}
+#else
+	struct EventDefinition {
+		int group;
+		uint32_t type;
+		uint64_t config;
+	};
+
+	static constexpr uint64_t cacheMiss(uint64_t cache) {
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	}
+
+	//the first event of each group is its leader
+	static const EventDefinition eventDefinitions[CounterEventCount] = {
+		{ 0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ 0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ 0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ 1, PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D) },
+		{ 1, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+		{ 1, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ 2, PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_DTLB) },
+		{ 2, PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_ITLB) },
+	};
+
+	static int openEvent(const EventDefinition& event, int groupFd) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = event.type;
+		attr.config = event.config;
+		attr.disabled = groupFd < 0;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+	}
+
+	bool PerfCounters::start() {
+		bool any = false;
+		for (int i = 0; i < CounterEventCount; ++i) {
+			const EventDefinition& event = eventDefinitions[i];
+			//a group whose leader can't be opened is skipped entirely
+			if (leaders[event.group] < 0 && i > 0 && eventDefinitions[i - 1].group == event.group)
+				continue;
+			fds[i] = openEvent(event, leaders[event.group]);
+			if (fds[i] < 0) {
+				if (error.empty())
+					error = std::string("perf_event_open: ") + strerror(errno);
+				continue;
+			}
+			if (leaders[event.group] < 0)
+				leaders[event.group] = fds[i];
+			any = true;
+		}
+		for (int g = 0; g < GroupCount; ++g) {
+			if (leaders[g] >= 0)
+				ioctl(leaders[g], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		}
+		return any;
+	}
+
+	void PerfCounters::stop() {
+		for (int g = 0; g < GroupCount; ++g) {
+			if (leaders[g] < 0)
+				continue;
+			ioctl(leaders[g], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+			//a group read returns the values of the open members in the order they were opened
+			uint64_t data[3 + CounterEventCount];
+			if (read(leaders[g], data, sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t)))
+				continue;
+			uint64_t count = data[0], enabled = data[1], running = data[2];
+			if (running == 0)
+				continue;
+			double scale = (double)enabled / running;
+			if (1.0 / scale < minCoverage)
+				minCoverage = 1.0 / scale;
+			for (int j = 0, k = 0; j < CounterEventCount && k < (int)count; ++j) {
+				if (eventDefinitions[j].group != g || fds[j] < 0)
+					continue;
+				values[j] += data[3 + k++] * scale;
+				available[j] = true;
+			}
+		}
+		close();
+	}
+
+	void PerfCounters::close() {
+		for (int i = 0; i < CounterEventCount; ++i) {
+			if (fds[i] >= 0)
+				::close(fds[i]);
+			fds[i] = -1;
+		}
+		for (int g = 0; g < GroupCount; ++g)
+			leaders[g] = -1;
+	}
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace RandomX {
+
+	enum CounterEvent {
+		CounterCycles,
+		CounterInstructions,
+		CounterBranchMisses,
+		CounterL1dMisses,
+		CounterL2Misses,     //LLC references, the generic events have no L2 miss counter
+		CounterLlcMisses,
+		CounterDtlbMisses,
+		CounterItlbMisses,
+		CounterEventCount
+	};
+
+	/*
+		Hardware performance counters of one thread, opened with perf_event_open.
+		The events are split into small groups (core, caches, TLBs) that fit in
+		the PMU together with other users; each group is scaled by the fraction
+		of time it was scheduled. Events the kernel or the CPU doesn't provide
+		are left unavailable instead of failing. The counters run from start() to
+		stop(), so they include everything the thread does in between, e.g. the
+		nonce handling and hashing of the seed and the scratchpad fill, not only
+		the execution of the programs.
+	*/
+	class PerfCounters {
+	public:
+		PerfCounters();
+		~PerfCounters();
+		//opens and enables the counters of the calling thread, returns false if none is available
+		bool start();
+		//disables the counters and adds their values
+		void stop();
+		void merge(const PerfCounters&);
+		bool isAvailable(CounterEvent event) const {
+			return available[event];
+		}
+		double getValue(CounterEvent event) const {
+			return values[event];
+		}
+		const std::string& getError() const {
+			return error;
+		}
+		//prints the counter values divided by 'hashCount', or only a note if no hash was counted
+		void printReport(std::ostream& os, uint64_t hashCount) const;
+	private:
+		static constexpr int GroupCount = 3;
+		int fds[CounterEventCount];
+		int leaders[GroupCount];
+		bool available[CounterEventCount];
+		double values[CounterEventCount];
+		double minCoverage; //lowest fraction of the time a group was counting
+		std::string error;
+
+		void close();
+	};
+
+}
@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "PerfJitLog.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace RandomX {
+
+#ifndef __linux__
+	PerfJitLog::PerfJitLog(bool jitdump, bool instructionMarkers) {
+		throw std::runtime_error("perf map and jitdump files are only supported on Linux");
+	}
+
+	PerfJitLog::~PerfJitLog() {
+
+	}
+
+	void PerfJitLog::addCode(const uint8_t* code, const uint8_t* exec, uint32_t offset, uint32_t size, const char* name, const std::vector<CodeMarker>* markers) {
+
+	}
+
+	void PerfJitLog::writeRecordHeader(uint32_t id, uint32_t size, uint64_t timestamp) {
+
+	}
+#else
+	//see tools/perf/Documentation/jitdump-specification.txt in the Linux sources
+	constexpr uint32_t JitdumpMagic = 0x4A695444;
+	constexpr uint32_t JitdumpVersion = 1;
+	constexpr uint32_t JitdumpMachineX86_64 = 62;
+	constexpr uint32_t JitCodeLoad = 0;
+	constexpr uint32_t JitCodeClose = 3;
+	constexpr uint32_t JitCodeDebugInfo = 2;
+
+	struct JitdumpHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t size;
+		uint32_t machine;
+		uint32_t pad;
+		uint32_t pid;
+		uint64_t timestamp;
+		uint64_t flags;
+	};
+
+	struct JitdumpRecordHeader {
+		uint32_t id;
+		uint32_t size;
+		uint64_t timestamp;
+	};
+
+	struct JitdumpCodeLoad {
+		uint32_t pid;
+		uint32_t tid;
+		uint64_t vma;
+		uint64_t address;
+		uint64_t size;
+		uint64_t index;
+	};
+
+	struct JitdumpDebugEntry {
+		uint64_t address;
+		int32_t line;
+		int32_t discriminator;
+	};
+
+	static uint64_t monotonicTime() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+	PerfJitLog::PerfJitLog(bool jitdump, bool instructionMarkers) : jitdump(jitdump), instructionMarkers(instructionMarkers), marker(nullptr), codeIndex(0), pid(getpid()) {
+		if (instructionMarkers && !jitdump)
+			throw std::runtime_error("Instruction markers require the jitdump format");
+		snprintf(path, sizeof(path), jitdump ? "/tmp/jit-%d.dump" : "/tmp/perf-%d.map", pid);
+		file = fopen(path, jitdump ? "w+b" : "a");
+		if (file == nullptr)
+			throw std::runtime_error(std::string("Cannot open ") + path);
+		if (jitdump) {
+			JitdumpHeader header = { JitdumpMagic, JitdumpVersion, sizeof(JitdumpHeader), JitdumpMachineX86_64, 0, (uint32_t)pid, monotonicTime(), 0 };
+			fwrite(&header, sizeof(header), 1, file);
+			fflush(file);
+			//perf finds the jitdump file through the mmap event of an executable mapping
+			marker = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(file), 0);
+			if (marker == MAP_FAILED) {
+				fclose(file);
+				throw std::runtime_error(std::string("Cannot map ") + path);
+			}
+		}
+	}
+
+	PerfJitLog::~PerfJitLog() {
+		if (jitdump) {
+			writeRecordHeader(JitCodeClose, sizeof(JitdumpRecordHeader), monotonicTime());
+			munmap(marker, sysconf(_SC_PAGESIZE));
+		}
+		fclose(file);
+	}
+
+	void PerfJitLog::writeRecordHeader(uint32_t id, uint32_t size, uint64_t timestamp) {
+		JitdumpRecordHeader header = { id, size, timestamp };
+		fwrite(&header, sizeof(header), 1, file);
+	}
+
+	void PerfJitLog::addCode(const uint8_t* code, const uint8_t* exec, uint32_t offset, uint32_t size, const char* name, const std::vector<CodeMarker>* markers) {
+		if (size == 0)
+			return;
+		char symbol[64];
+		snprintf(symbol, sizeof(symbol), "randomx_%s", name);
+		std::lock_guard<std::mutex> lock(mutex);
+		uint64_t address = (uint64_t)(exec + offset);
+		if (!jitdump) {
+			fprintf(file, "%llx %x %s\n", (unsigned long long)address, size, symbol);
+			fflush(file);
+			return;
+		}
+		uint64_t timestamp = monotonicTime();
+		if (markers != nullptr && !markers->empty()) {
+			uint32_t recordSize = sizeof(JitdumpRecordHeader) + 2 * sizeof(uint64_t);
+			for (const CodeMarker& m : *markers)
+				recordSize += sizeof(JitdumpDebugEntry) + strlen(m.name) + 1;
+			writeRecordHeader(JitCodeDebugInfo, recordSize, timestamp);
+			uint64_t count = markers->size();
+			fwrite(&address, sizeof(address), 1, file);
+			fwrite(&count, sizeof(count), 1, file);
+			for (const CodeMarker& m : *markers) {
+				JitdumpDebugEntry entry = { (uint64_t)(exec + m.offset), (int32_t)m.line, 0 };
+				fwrite(&entry, sizeof(entry), 1, file);
+				fwrite(m.name, strlen(m.name) + 1, 1, file);
+			}
+		}
+		uint32_t nameSize = strlen(symbol) + 1;
+		writeRecordHeader(JitCodeLoad, sizeof(JitdumpRecordHeader) + sizeof(JitdumpCodeLoad) + nameSize + size, timestamp);
+		JitdumpCodeLoad load = { (uint32_t)pid, (uint32_t)syscall(SYS_gettid), address, address, size, codeIndex++ };
+		fwrite(&load, sizeof(load), 1, file);
+		fwrite(symbol, nameSize, 1, file);
+		fwrite(code + offset, size, 1, file);
+	}
+#endif
+}
@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace RandomX {
+
+	//start of the code generated for one program instruction, see PerfJitLog::addCode
+	struct CodeMarker {
+		uint32_t offset; //from the start of the code buffer
+		uint32_t line; //position of the instruction in the program + 1, 0 for generated helper code
+		const char* name;
+	};
+
+	/*
+		Describes the code generated by JitCompilerX86 to the Linux 'perf' tool,
+		so that samples in the code buffer are attributed to named regions
+		instead of '[unknown]'.
+
+		Map format: entries are appended to /tmp/perf-<pid>.map, which perf reads
+		when reporting. The map is static, so only regions at fixed offsets of the
+		code buffer can be described there.
+
+		Jitdump format: records are appended to /tmp/jit-<pid>.dump with the code
+		bytes of every region of every compiled program, timestamped with
+		CLOCK_MONOTONIC. Use 'perf record -k mono' followed by 'perf inject --jit'.
+		Instruction markers are stored as debug line information of the program
+		region, so 'perf annotate' shows the program instruction of each line.
+	*/
+	class PerfJitLog {
+	public:
+		PerfJitLog(bool jitdump, bool instructionMarkers);
+		~PerfJitLog();
+		bool isJitDump() const {
+			return jitdump;
+		}
+		bool hasInstructionMarkers() const {
+			return instructionMarkers;
+		}
+		const char* getPath() const {
+			return path;
+		}
+		//'code' and 'exec' are the writable and executable views of the same code buffer
+		void addCode(const uint8_t* code, const uint8_t* exec, uint32_t offset, uint32_t size, const char* name, const std::vector<CodeMarker>* markers = nullptr);
+	private:
+		bool jitdump;
+		bool instructionMarkers;
+		char path[64];
+		std::mutex mutex;
+		FILE* file;
+		void* marker; //executable mapping of the jitdump file that perf records as a marker
+		uint64_t codeIndex;
+		int pid;
+
+		void writeRecordHeader(uint32_t id, uint32_t size, uint64_t timestamp);
+	};
+
+}
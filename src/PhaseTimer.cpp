@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "PhaseTimer.hpp"
+#include <algorithm>
+#include <iomanip>
+
+namespace RandomX {
+
+	static const char* phaseNames[PhaseCount] = {
+		"seed (blake2b)",
+		"scratchpad (fillAes1Rx4)",
+		"program (fillAes1Rx4)",
+		"initialize (JIT compile)",
+		"execute",
+		"getResult",
+		"final result (hashAes1Rx4)",
+	};
+
+	void PhaseTimer::merge(const PhaseTimer& other) {
+		for (int i = 0; i < PhaseCount; ++i)
+			samples[i].insert(samples[i].end(), other.samples[i].begin(), other.samples[i].end());
+	}
+
+	void PhaseTimer::printReport(std::ostream& os, double ticksPerNs) {
+		uint64_t totals[PhaseCount], total = 0;
+		for (int i = 0; i < PhaseCount; ++i) {
+			totals[i] = 0;
+			for (uint64_t sample : samples[i])
+				totals[i] += sample;
+			total += totals[i];
+		}
+		os << std::setw(28) << std::left << "phase" << std::right << std::setw(8) << "count" << std::setw(12) << "p50 [us]";
+		os << std::setw(12) << "p90 [us]" << std::setw(12) << "p99 [us]" << std::setw(12) << "max [us]" << std::setw(9) << "share" << std::endl;
+		os << std::fixed << std::setprecision(2);
+		for (int i = 0; i < PhaseCount; ++i) {
+			std::vector<uint64_t>& s = samples[i];
+			if (s.empty())
+				continue;
+			std::sort(s.begin(), s.end());
+			auto percentile = [&](double p) {
+				return s[std::min(s.size() - 1, (size_t)(p / 100 * s.size()))] / ticksPerNs / 1000;
+			};
+			os << std::setw(28) << std::left << phaseNames[i] << std::right << std::setw(8) << s.size();
+			os << std::setw(12) << percentile(50) << std::setw(12) << percentile(90) << std::setw(12) << percentile(99);
+			os << std::setw(12) << s.back() / ticksPerNs / 1000 << std::setw(8) << 100.0 * totals[i] / total << "%" << std::endl;
+		}
+		os << std::defaultfloat;
+	}
+
+}
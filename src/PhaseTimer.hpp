@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+//#define PHASE_TIMING
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#ifdef PHASE_TIMING
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace RandomX {
+
+	enum Phase {
+		PhaseSeed,          //blake2b of the block template
+		PhaseScratchpad,    //fillAes1Rx4 of the scratchpad
+		PhaseProgram,       //fillAes1Rx4 of a program
+		PhaseInitialize,    //VirtualMachine::initialize (JIT compilation)
+		PhaseExecute,       //program execution
+		PhaseResult,        //getResult of a chain program
+		PhaseFinalResult,   //hashAes1Rx4 of the scratchpad and getResult of the last program
+		PhaseCount
+	};
+
+	/*
+		Per-thread timestamps of the phases of a hash. Each lap() records the TSC
+		delta since the previous start() or lap(). The instrumentation is only
+		compiled with PHASE_TIMING (make timing); otherwise start() and lap() are
+		empty and the hot path has no timing code.
+	*/
+	class PhaseTimer {
+	public:
+		PhaseTimer() : mark(0) {}
+		static constexpr bool enabled() {
+#ifdef PHASE_TIMING
+			return true;
+#else
+			return false;
+#endif
+		}
+		static uint64_t ticks() {
+#if !defined(PHASE_TIMING)
+			return 0;
+#elif defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+		void start() {
+#ifdef PHASE_TIMING
+			mark = ticks();
+#endif
+		}
+		void lap(Phase phase) {
+#ifdef PHASE_TIMING
+			uint64_t now = ticks();
+			samples[phase].push_back(now - mark);
+			mark = now;
+#endif
+		}
+		void merge(const PhaseTimer& other);
+		//prints percentiles of each phase, 'ticksPerNs' converts them to time
+		void printReport(std::ostream& os, double ticksPerNs);
+	private:
+		std::vector<uint64_t> samples[PhaseCount];
+		uint64_t mark;
+	};
+
+}
@@ -0,0 +1,112 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "ProgramCorpus.hpp"
+
+namespace RandomX {
+
+	static const char Magic[8] = { 'R', 'X', 'C', 'O', 'R', 'P', 'U', 'S' };
+
+	/*
+		File layout:
+		header: magic (8 bytes), version, sizeof(Program), sizeof(RegisterFile) (uint32 each), cache seed (32 bytes)
+		hash: scratchpad seed (64 bytes), program count (uint32), programs
+		program: Program, RegisterFile, ma, mx, rounding mode (uint32 each), result (64 bytes)
+	*/
+	struct CorpusHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t programSize;
+		uint32_t registerFileSize;
+		uint8_t cacheSeed[32];
+	};
+
+	template<typename T>
+	static void writeField(std::ofstream& file, const T& value) {
+		file.write((const char*)&value, sizeof(T));
+	}
+
+	template<typename T>
+	static bool readField(std::ifstream& file, T& value) {
+		return (bool)file.read((char*)&value, sizeof(T));
+	}
+
+	void ProgramCorpus::load(const std::string& path) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			throw std::runtime_error("Cannot open corpus file " + path);
+		CorpusHeader header;
+		if (!readField(in, header) || memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+			throw std::runtime_error(path + " is not a program corpus");
+		if (header.version != Version || header.programSize != sizeof(Program) || header.registerFileSize != sizeof(RegisterFile))
+			throw std::runtime_error(path + " was written by an incompatible version");
+		memcpy(cacheSeed, header.cacheSeed, sizeof(cacheSeed));
+		hashes.clear();
+		CorpusHash hash;
+		while (readField(in, hash.scratchpadSeed)) {
+			uint32_t count;
+			if (!readField(in, count) || count > ChainLength)
+				throw std::runtime_error("Invalid hash " + std::to_string(hashes.size()) + " in " + path);
+			hash.programs.resize(count);
+			for (CorpusProgram& p : hash.programs) {
+				if (!readField(in, p.program) || !readField(in, p.registers) || !readField(in, p.ma) || !readField(in, p.mx) || !readField(in, p.roundingMode) || !readField(in, p.result))
+					throw std::runtime_error("Truncated hash " + std::to_string(hashes.size()) + " in " + path);
+			}
+			hashes.push_back(hash);
+		}
+	}
+
+	void ProgramCorpus::create(const std::string& path, const uint8_t* seed) {
+		memcpy(cacheSeed, seed, sizeof(cacheSeed));
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			throw std::runtime_error("Cannot create corpus file " + path);
+		CorpusHeader header;
+		memcpy(header.magic, Magic, sizeof(Magic));
+		header.version = Version;
+		header.programSize = sizeof(Program);
+		header.registerFileSize = sizeof(RegisterFile);
+		memcpy(header.cacheSeed, cacheSeed, sizeof(cacheSeed));
+		writeField(file, header);
+	}
+
+	void ProgramCorpus::add(const CorpusHash& hash) {
+		std::lock_guard<std::mutex> lock(mutex);
+		writeField(file, hash.scratchpadSeed);
+		writeField(file, (uint32_t)hash.programs.size());
+		for (const CorpusProgram& p : hash.programs) {
+			writeField(file, p.program);
+			writeField(file, p.registers);
+			writeField(file, p.ma);
+			writeField(file, p.mx);
+			writeField(file, p.roundingMode);
+			writeField(file, p.result);
+		}
+	}
+
+	size_t ProgramCorpus::getProgramCount() const {
+		size_t count = 0;
+		for (const CorpusHash& hash : hashes)
+			count += hash.programs.size();
+		return count;
+	}
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "Program.hpp"
+
+namespace RandomX {
+
+	//one program of a chain: the VM state after initialize() and the result after execute()
+	struct CorpusProgram {
+		Program program;
+		RegisterFile registers;
+		addr_t ma, mx;
+		uint32_t roundingMode; //left by the previous program, see getRoundMode()
+		uint8_t result[ResultSize]; //blake2b of the register file after execution
+	};
+
+	//the programs of one hash, in chain order
+	struct CorpusHash {
+		alignas(16) uint64_t scratchpadSeed[8]; //input of fillAes1Rx4 for the scratchpad
+		std::vector<CorpusProgram> programs;
+	};
+
+	/*
+		Binary file of the programs executed by a benchmark run, written with
+		--capture. Programs are stored with the initial VM state, so that a
+		corpus can be replayed by any VM, e.g. to compare code generation changes
+		on the same workload. Hashes are appended as they finish, which makes the
+		order of the hashes of different threads arbitrary. All fields are stored
+		in the byte order of the host.
+	*/
+	class ProgramCorpus {
+	public:
+		static constexpr uint32_t Version = 1;
+
+		//reads all hashes of a corpus file
+		void load(const std::string& path);
+		//starts a corpus file for programs that read the cache or dataset with the given key
+		void create(const std::string& path, const uint8_t* cacheSeed);
+		//appends one hash to the created file, thread-safe
+		void add(const CorpusHash&);
+		//false if the file couldn't be written
+		bool good() const {
+			return (bool)file;
+		}
+		const uint8_t* getCacheSeed() const {
+			return cacheSeed;
+		}
+		const std::vector<CorpusHash>& getHashes() const {
+			return hashes;
+		}
+		size_t getProgramCount() const;
+	private:
+		uint8_t cacheSeed[32];
+		std::vector<CorpusHash> hashes;
+		std::ofstream file;
+		std::mutex mutex;
+	};
+
+}
@@ -0,0 +1,302 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include "ProgramCostModel.hpp"
+#include "Program.hpp"
+#include "InstructionScheduler.hpp"
+#include "instructionOperands.hpp"
+
+namespace RandomX {
+
+	static const char* portNames[PortClassCount] = { "ALU", "multiplier", "FPU", "divider", "load", "store" };
+	static const double portWidth[PortClassCount] = { 4, 1, 2, 1, 2, 1 };
+	constexpr double FrontEndWidth = 4;
+
+	//uops of the generated code per port class; divider use is the reciprocal throughput of the instruction
+	static const uint8_t portUse[][PortClassCount] = {
+		{ 1, 0, 0, 0, 0, 0 }, //IADD_R
+		{ 2, 0, 0, 0, 1, 0 }, //IADD_M
+		{ 1, 0, 0, 0, 0, 0 }, //IADD_RC
+		{ 1, 0, 0, 0, 0, 0 }, //ISUB_R
+		{ 2, 0, 0, 0, 1, 0 }, //ISUB_M
+		{ 1, 0, 0, 0, 0, 0 }, //IMUL_9C
+		{ 0, 1, 0, 0, 0, 0 }, //IMUL_R
+		{ 2, 1, 0, 0, 1, 0 }, //IMUL_M
+		{ 1, 1, 0, 0, 0, 0 }, //IMULH_R
+		{ 3, 1, 0, 0, 1, 0 }, //IMULH_M
+		{ 2, 1, 0, 0, 0, 0 }, //ISMULH_R
+		{ 4, 1, 0, 0, 1, 0 }, //ISMULH_M
+		{ 3, 1, 0, 0, 0, 0 }, //IDIV_C
+		{ 4, 1, 0, 0, 0, 0 }, //ISDIV_C
+		{ 1, 0, 0, 0, 0, 0 }, //INEG_R
+		{ 1, 0, 0, 0, 0, 0 }, //IXOR_R
+		{ 2, 0, 0, 0, 1, 0 }, //IXOR_M
+		{ 3, 0, 0, 0, 0, 0 }, //IROR_R
+		{ 3, 0, 0, 0, 0, 0 }, //IROL_R
+		{ 1, 0, 0, 0, 0, 0 }, //ISWAP_R
+		{ 0, 0, 1, 0, 0, 0 }, //FSWAP_R
+		{ 0, 0, 1, 0, 0, 0 }, //FADD_R
+		{ 2, 0, 2, 0, 1, 0 }, //FADD_M
+		{ 0, 0, 1, 0, 0, 0 }, //FSUB_R
+		{ 2, 0, 2, 0, 1, 0 }, //FSUB_M
+		{ 0, 0, 1, 0, 0, 0 }, //FSCAL_R
+		{ 0, 0, 1, 0, 0, 0 }, //FMUL_R
+		{ 2, 0, 2, 0, 1, 0 }, //FMUL_M
+		{ 0, 0, 1, 1, 0, 0 }, //FDIV_R
+		{ 2, 0, 4, 1, 1, 0 }, //FDIV_M
+		{ 0, 0, 1, 1, 0, 0 }, //FSQRT_R
+		{ 4, 0, 0, 0, 0, 0 }, //COND_R
+		{ 5, 0, 0, 0, 1, 0 }, //COND_M
+		{ 3, 0, 0, 0, 1, 1 }, //CFROUND
+		{ 2, 0, 0, 0, 0, 1 }, //ISTORE
+		{ 2, 0, 0, 0, 0, 1 }, //FSTORE
+		{ 0, 0, 0, 0, 0, 0 }, //NOP
+	};
+
+	static_assert(sizeof(portUse) / sizeof(portUse[0]) == InstructionTypeCount, "Invalid port use table");
+
+	//uops of the loop load, dataset read and loop store of every iteration
+	static const double loopPortUse[PortClassCount] = { 18, 0, 16, 0, 24, 12 };
+
+	//the scratchpad lines read at the start of an iteration are prefetched into L1 (see JitCompilerX86)
+	constexpr double LoopLoadLatency = 7; //xor and mask of the address registers, L1 load
+	constexpr double LoopXorLatency = 2; //xor with the scratchpad line and with the dataset line
+	constexpr int LoopInstructions = 40; //instructions of the loop load, dataset read and loop store
+	constexpr int WindowIterations = 4;
+
+	constexpr double NoPath = -std::numeric_limits<double>::infinity();
+
+	ProgramCostModel::ProgramCostModel(const InstructionCosts& costs, int window) : costs(costs), window(window) {
+
+	}
+
+	static void forEachResource(uint32_t resources, int limit, const std::function<void(int)>& f) {
+		for (int r = 0; r < limit; ++r) {
+			if (resources & (1U << r))
+				f(r);
+		}
+	}
+
+	//index of the scratchpad level read by an instruction with a memory operand
+	static int loadLevel(Instruction& instr) {
+		if (instr.src == instr.dst)
+			return 2;
+		return (instr.mod % 4) ? 0 : 1;
+	}
+
+	/*
+		Issues WindowIterations iterations in order into a reorder window of 'window'
+		entries at FrontEndWidth instructions per cycle. An instruction starts when its
+		operands are ready and retires in order. Between iterations the registers
+		wait for the scratchpad line addressed by readReg0 ^ readReg1. Returns the
+		average cycles per iteration after the first one.
+	*/
+	double ProgramCostModel::simulateWindow(Program& prog, const uint8_t* order, int readReg0, int readReg1) {
+		double ready[ResourceCount] = { 0 };
+		std::vector<double> retire;
+		retire.reserve(WindowIterations * (ProgramLength + LoopInstructions));
+		double firstIteration = 0;
+		for (int iteration = 0; iteration < WindowIterations; ++iteration) {
+			auto issue = [&](double operands, double latency) {
+				size_t k = retire.size();
+				double start = std::max(operands, k / FrontEndWidth);
+				if (k >= (size_t)window)
+					start = std::max(start, retire[k - window]);
+				double finish = start + latency;
+				retire.push_back(k > 0 ? std::max(retire[k - 1], finish) : finish);
+				return finish;
+			};
+			//loop overhead: scratchpad address, loads and xors into the registers
+			double line = issue(std::max(ready[readReg0], ready[readReg1]), LoopLoadLatency);
+			for (int i = 1; i < LoopInstructions; ++i)
+				issue(line, LoopXorLatency);
+			for (int r = 0; r < ResourceRounding; ++r)
+				ready[r] = std::max(ready[r], line) + LoopXorLatency;
+			for (int k = 0; k < ProgramLength; ++k) {
+				Instruction& instr = prog(order != nullptr ? order[k] : k);
+				uint32_t reads, writes;
+				getResources(instr, reads, writes);
+				double operands = 0;
+				forEachResource(reads & ~(1U << ResourceMemory), ResourceCount, [&](int r) { operands = std::max(operands, ready[r]); });
+				double finish = issue(operands, costs.latency[instructionType[instr.opcode]]);
+				forEachResource(writes & ~(1U << ResourceMemory), ResourceCount, [&](int r) { ready[r] = finish; });
+			}
+			if (iteration == 0)
+				firstIteration = retire.back();
+		}
+		return (retire.back() - firstIteration) / (WindowIterations - 1);
+	}
+
+	ProgramCost ProgramCostModel::analyze(Program& prog) {
+		ProgramCost cost;
+		for (int i = 0; i < ProgramLength; ++i) {
+			prog(i).src %= RegistersCount;
+			prog(i).dst %= RegistersCount;
+		}
+		uint64_t addressRegisters = prog.getEntropy(12);
+		int readReg0 = 0 + (addressRegisters & 1);
+		int readReg1 = 2 + ((addressRegisters >> 1) & 1);
+
+		//critical path and memory-level parallelism of one iteration
+		double ready[ResourceCount] = { 0 };
+		int writer[ResourceCount];
+		int loadDepth[ResourceCount];
+		std::fill(writer, writer + ResourceCount, -1);
+		std::fill(loadDepth, loadDepth + ResourceCount, 1); //the registers are xored with a scratchpad line
+		int predecessor[ProgramLength];
+		double finish[ProgramLength];
+		double uses[PortClassCount];
+		std::copy(loopPortUse, loopPortUse + PortClassCount, uses);
+		cost.loads[0] = cost.loads[1] = cost.loads[2] = 0;
+		int maxLoadDepth = 1;
+		for (int i = 0; i < ProgramLength; ++i) {
+			Instruction& instr = prog(i);
+			int type = instructionType[instr.opcode];
+			uint32_t reads, writes;
+			getResources(instr, reads, writes);
+			double start = 0;
+			int depth = 0;
+			predecessor[i] = -1;
+			forEachResource(reads & ~(1U << ResourceMemory), ResourceCount, [&](int r) {
+				if (ready[r] > start) {
+					start = ready[r];
+					predecessor[i] = writer[r];
+				}
+				depth = std::max(depth, loadDepth[r]);
+			});
+			if (reads & (1U << ResourceMemory)) {
+				cost.loads[loadLevel(instr)]++;
+				depth++;
+			}
+			maxLoadDepth = std::max(maxLoadDepth, depth);
+			finish[i] = start + costs.latency[type];
+			forEachResource(writes & ~(1U << ResourceMemory), ResourceCount, [&](int r) {
+				ready[r] = finish[i];
+				writer[r] = i;
+				loadDepth[r] = depth;
+			});
+			for (int p = 0; p < PortClassCount; ++p)
+				uses[p] += p == PortDivider ? portUse[type][p] * costs.throughput[type] : portUse[type][p];
+		}
+		int last = std::max_element(finish, finish + ProgramLength) - finish;
+		cost.criticalPath = finish[last];
+		for (int i = last; i >= 0; i = predecessor[i])
+			cost.criticalInstructions.push_back(i);
+		std::reverse(cost.criticalInstructions.begin(), cost.criticalInstructions.end());
+		//two scratchpad lines and one dataset line are read by every iteration
+		int totalLoads = cost.loads[0] + cost.loads[1] + cost.loads[2] + 3;
+		cost.mlp = (double)totalLoads / (maxLoadDepth + 1);
+
+		//resource bound
+		double uops = 0;
+		cost.resource = 0;
+		cost.resourceName = portNames[0];
+		for (int p = 0; p < PortClassCount; ++p) {
+			if (p != PortDivider)
+				uops += uses[p];
+			if (uses[p] / portWidth[p] > cost.resource) {
+				cost.resource = uses[p] / portWidth[p];
+				cost.resourceName = portNames[p];
+			}
+		}
+		if (uops / FrontEndWidth > cost.resource) {
+			cost.resource = uops / FrontEndWidth;
+			cost.resourceName = "front end";
+		}
+
+		/*
+			Recurrence bound: the longest path from the value of integer register y at
+			the start of an iteration to the value of x at its end, plus the work of
+			the loop between iterations, gives the weight of the edge y -> x. The
+			bound is the maximum cycle mean of this graph (Karp's algorithm).
+		*/
+		double path[RegistersCount][RegistersCount];
+		for (int y = 0; y < RegistersCount; ++y) {
+			double t[RegistersCount];
+			for (int r = 0; r < RegistersCount; ++r)
+				t[r] = r == y ? 0 : NoPath;
+			for (int i = 0; i < ProgramLength; ++i) {
+				Instruction& instr = prog(i);
+				uint32_t reads, writes;
+				getResources(instr, reads, writes);
+				double start = NoPath;
+				forEachResource(reads, RegistersCount, [&](int r) { start = std::max(start, t[r]); });
+				double result = start == NoPath ? NoPath : start + costs.latency[instructionType[instr.opcode]];
+				//a written register no longer depends on y unless the result does
+				forEachResource(writes, RegistersCount, [&](int r) { t[r] = result; });
+			}
+			for (int x = 0; x < RegistersCount; ++x)
+				path[y][x] = t[x];
+		}
+		double edge[RegistersCount][RegistersCount];
+		for (int y = 0; y < RegistersCount; ++y) {
+			//every register of the next iteration waits for the scratchpad line addressed by readReg0 ^ readReg1
+			double viaAddress = std::max(path[y][readReg0], path[y][readReg1]);
+			for (int x = 0; x < RegistersCount; ++x) {
+				double w = path[y][x] == NoPath ? NoPath : path[y][x] + LoopXorLatency;
+				if (viaAddress != NoPath)
+					w = std::max(w, viaAddress + LoopLoadLatency + LoopXorLatency);
+				edge[y][x] = w;
+			}
+		}
+		double walk[RegistersCount + 1][RegistersCount];
+		for (int v = 0; v < RegistersCount; ++v)
+			walk[0][v] = 0;
+		for (int k = 1; k <= RegistersCount; ++k) {
+			for (int v = 0; v < RegistersCount; ++v) {
+				walk[k][v] = NoPath;
+				for (int u = 0; u < RegistersCount; ++u) {
+					if (walk[k - 1][u] != NoPath && edge[u][v] != NoPath)
+						walk[k][v] = std::max(walk[k][v], walk[k - 1][u] + edge[u][v]);
+				}
+			}
+		}
+		cost.recurrence = 0;
+		for (int v = 0; v < RegistersCount; ++v) {
+			if (walk[RegistersCount][v] == NoPath)
+				continue;
+			double mean = std::numeric_limits<double>::infinity();
+			for (int k = 0; k < RegistersCount; ++k) {
+				if (walk[k][v] != NoPath)
+					mean = std::min(mean, (walk[RegistersCount][v] - walk[k][v]) / (RegistersCount - k));
+			}
+			cost.recurrence = std::max(cost.recurrence, mean);
+		}
+
+		cost.window = simulateWindow(prog, nullptr, readReg0, readReg1);
+		InstructionScheduler scheduler;
+		scheduler.setCosts(costs);
+		cost.windowScheduled = simulateWindow(prog, scheduler.schedule(prog), readReg0, readReg1);
+
+		cost.estimate = cost.recurrence;
+		cost.bound = "recurrence";
+		if (cost.resource > cost.estimate) {
+			cost.estimate = cost.resource;
+			cost.bound = "resources";
+		}
+		if (cost.window > cost.estimate) {
+			cost.estimate = cost.window;
+			cost.bound = "window";
+		}
+		return cost;
+	}
+}
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "common.hpp"
+#include "InstructionCosts.hpp"
+
+namespace RandomX {
+
+	class Program;
+
+	enum PortClass {
+		PortAlu,
+		PortMul,
+		PortFpu,
+		PortDivider,
+		PortLoad,
+		PortStore,
+		PortClassCount
+	};
+
+	struct ProgramCost {
+		double criticalPath; //longest dependency chain of one iteration, all inputs ready at the start
+		double recurrence; //cycles per iteration imposed by the integer registers carried between iterations
+		double resource; //cycles per iteration needed by the busiest port class or the front end
+		const char* resourceName;
+		double window; //cycles per iteration of consecutive iterations issued in program order into a window of limited size
+		double windowScheduled; //the same in the order of InstructionScheduler
+		double estimate; //cycles per iteration, the largest of recurrence, resource and window
+		const char* bound; //which of them is the largest
+		int loads[3]; //scratchpad loads of the program body from L1, L2 and L3
+		double mlp; //memory-level parallelism: loads per iteration / most loads on one dependency chain
+		std::vector<uint8_t> criticalInstructions; //program positions on the critical path
+	};
+
+	/*
+		Static estimate of the cost of a program before it runs. The dependency
+		graph of the 256 instructions (true dependencies through registers and the
+		rounding mode only, scratchpad addresses are unknown) is weighted with the
+		instruction latencies of an InstructionCosts profile. Port use is modelled
+		per instruction type for a generic core with 4 ALU, 1 multiplier, 2 FPU,
+		2 load and 1 store ports and a 4-wide front end. The fixed work of the VM
+		loop (scratchpad loads and stores, dataset read) is included.
+	*/
+	class ProgramCostModel {
+	public:
+		ProgramCostModel(const InstructionCosts& costs, int window = 64);
+		//src and dst of the program instructions are reduced modulo RegistersCount
+		ProgramCost analyze(Program&);
+	private:
+		InstructionCosts costs;
+		int window;
+
+		double simulateWindow(Program&, const uint8_t* order, int readReg0, int readReg1);
+	};
+
+}
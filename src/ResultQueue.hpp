@@ -0,0 +1,59 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace RandomX {
+
+	struct Share {
+		uint32_t jobId;
+		uint32_t nonce;
+		uint64_t hash[4];
+	};
+
+	/*
+		Bounded lock-free queue of shares found by the hashing threads. Any thread
+		may push, one thread pops. Each cell has a sequence number that tells
+		whether it is free for the producer of a given position or holds the
+		share for the consumer of that position.
+	*/
+	class ResultQueue {
+	public:
+		ResultQueue(size_t capacity);
+		//returns false if the queue is full
+		bool push(const Share& share);
+		//returns false if the queue is empty
+		bool pop(Share& share);
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			Share share;
+		};
+		std::unique_ptr<Cell[]> cells;
+		size_t mask;
+		alignas(64) std::atomic<size_t> enqueuePos;
+		alignas(64) std::atomic<size_t> dequeuePos;
+	};
+
+}
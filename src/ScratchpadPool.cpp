@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <new>
+#include "ScratchpadPool.hpp"
+#include "intrinPortable.h"
+
+namespace RandomX {
+
+	ScratchpadPool::ScratchpadPool(unsigned threadCount, bool largePages, uint32_t colorStride) : slots(threadCount), largePages(largePages), colorStride(colorStride) {
+		for (auto& slot : slots) {
+			slot.memory = nullptr;
+			slot.pageSize = PageSize::Normal;
+		}
+	}
+
+	ScratchpadPool::~ScratchpadPool() {
+		for (auto& slot : slots) {
+			if (largePages) {
+				freeLargePagesMemory(slot.memory, slotSize(), slot.pageSize);
+			}
+			else {
+				_mm_free(slot.memory);
+			}
+		}
+	}
+
+	uint8_t* ScratchpadPool::acquire(unsigned thread) {
+		Slot& slot = slots[thread];
+		if (slot.memory == nullptr) {
+			if (largePages) {
+				slot.memory = allocLargePagesMemory(slotSize(), slot.pageSize);
+			}
+			else {
+				slot.memory = _mm_malloc(slotSize(), 4096);
+				if (slot.memory == nullptr)
+					throw std::bad_alloc();
+			}
+		}
+		return (uint8_t*)slot.memory + getColorOffset(thread, colorStride);
+	}
+}
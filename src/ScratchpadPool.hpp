@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "common.hpp"
+#include "virtualMemory.hpp"
+
+namespace RandomX {
+
+	constexpr uint32_t ScratchpadColorStride = 256;
+	constexpr uint32_t ScratchpadColors = 16;
+
+	/*
+		Per-thread scratchpads. Each thread allocates its own scratchpad on first use,
+		so that the memory is NUMA-local to the consuming thread (first-touch policy).
+		Consecutive threads are offset by a multiple of 'colorStride' bytes. With the
+		default stride all 16 offsets are below 4 KiB, so they change the L1 set index
+		(address bits 6-11) and the same scratchpad offset of two SMT siblings maps to
+		different L1 and L2 sets. The offset costs one extra 4 KiB page per thread, but
+		a whole extra page with 2 MiB pages, so scratchpads in large pages use a stride
+		of 0.
+	*/
+	class ScratchpadPool {
+	public:
+		ScratchpadPool(unsigned threadCount, bool largePages, uint32_t colorStride = ScratchpadColorStride);
+		~ScratchpadPool();
+		uint8_t* acquire(unsigned thread);
+		PageSize getPageSize(unsigned thread) const {
+			return slots[thread].pageSize;
+		}
+		static uint32_t getColorOffset(unsigned thread, uint32_t colorStride) {
+			return (thread % ScratchpadColors) * colorStride;
+		}
+	private:
+		struct Slot {
+			void* memory;
+			PageSize pageSize;
+		};
+		std::vector<Slot> slots;
+		bool largePages;
+		uint32_t colorStride;
+		size_t slotSize() const {
+			return ScratchpadSize + (ScratchpadColors - 1) * colorStride;
+		}
+	};
+}
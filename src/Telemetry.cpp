@@ -0,0 +1,228 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "Telemetry.hpp"
+#include "common.hpp"
+#include "intrinPortable.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace RandomX {
+
+	static const double HashrateWindows[] = { 1, 10, 60 };
+
+	ThreadCounters::ThreadCounters() : hashes(0), programs(0), compileTime(0), executeTime(0), codeBytes(0) {
+		for (int i = 0; i < LatencyBuckets; ++i)
+			latency[i].store(0, std::memory_order_relaxed);
+	}
+
+	Telemetry::Telemetry(unsigned threadCount) : threadCount(threadCount), startTime(std::chrono::steady_clock::now()), stopping(false), listenSocket(-1) {
+		counters = (ThreadCounters*)_mm_malloc(threadCount * sizeof(ThreadCounters), alignof(ThreadCounters));
+		if (counters == nullptr)
+			throw std::bad_alloc();
+		for (unsigned i = 0; i < threadCount; ++i)
+			new (&counters[i]) ThreadCounters();
+	}
+
+	Telemetry::~Telemetry() {
+		stop();
+#ifndef _WIN32
+		for (int client : clients)
+			close(client);
+		if (listenSocket >= 0) {
+			close(listenSocket);
+			unlink(filePath.c_str());
+		}
+#endif
+		for (unsigned i = 0; i < threadCount; ++i)
+			counters[i].~ThreadCounters();
+		_mm_free(counters);
+	}
+
+	void Telemetry::publishToFile(const std::string& path, unsigned interval) {
+		filePath = path;
+		start(interval);
+	}
+
+	void Telemetry::publishToSocket(const std::string& path, unsigned interval) {
+#ifdef _WIN32
+		throw std::runtime_error("Telemetry sockets are not supported on Windows");
+#else
+		sockaddr_un address = {};
+		if (path.size() >= sizeof(address.sun_path))
+			throw std::runtime_error("Telemetry socket path is too long");
+		address.sun_family = AF_UNIX;
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(path.c_str());
+		if (listenSocket < 0 || bind(listenSocket, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenSocket, 8) != 0)
+			throw std::runtime_error("Cannot listen on telemetry socket " + path);
+		fcntl(listenSocket, F_SETFL, fcntl(listenSocket, F_GETFL) | O_NONBLOCK);
+		filePath = path;
+		start(interval);
+#endif
+	}
+
+	void Telemetry::start(unsigned interval) {
+		publisher = std::thread([this, interval]() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!stopping) {
+				stopped.wait_for(lock, std::chrono::milliseconds(interval), [this] { return stopping; });
+				//the mutex only guards the stopping flag, stop() must not wait for file or socket I/O
+				lock.unlock();
+				publish();
+				lock.lock();
+			}
+		});
+	}
+
+	void Telemetry::stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		stopped.notify_one();
+		if (publisher.joinable())
+			publisher.join();
+	}
+
+	void Telemetry::publish() {
+		std::string json = toJson();
+		if (listenSocket >= 0) {
+			sendToClients(json);
+			return;
+		}
+		//readers never see a partially written file
+		std::string temporary = filePath + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::out | std::ios::trunc);
+			file << json << std::endl;
+		}
+		std::rename(temporary.c_str(), filePath.c_str());
+	}
+
+	void Telemetry::sendToClients(const std::string& json) {
+#ifndef _WIN32
+#ifdef MSG_NOSIGNAL
+		const int flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+		const int flags = MSG_DONTWAIT;
+#endif
+		int client;
+#ifdef SOCK_NONBLOCK
+		while ((client = accept4(listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+			clients.push_back(client);
+#else
+		while ((client = accept(listenSocket, nullptr, nullptr)) >= 0) {
+			fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+			clients.push_back(client);
+		}
+#endif
+		std::string line = json + "\n";
+		for (size_t i = 0; i < clients.size();) {
+			//a client that doesn't keep up (full socket buffer, EAGAIN or a short write) is disconnected
+			if (send(clients[i], line.data(), line.size(), flags) != (ssize_t)line.size()) {
+				close(clients[i]);
+				clients.erase(clients.begin() + i);
+			}
+			else {
+				++i;
+			}
+		}
+#endif
+	}
+
+	//thread ~0U selects the sum of all threads
+	void Telemetry::writeHashrates(std::ostream& os, unsigned thread) {
+		os << "\"hashrate\":{";
+		for (size_t w = 0; w < sizeof(HashrateWindows) / sizeof(HashrateWindows[0]); ++w) {
+			size_t last = history.size() - 1, first = last;
+			while (first > 0 && history[last].time - history[first - 1].time <= HashrateWindows[w] + 1e-3)
+				first--;
+			double elapsed = history[last].time - history[first].time;
+			uint64_t count = 0;
+			for (unsigned i = 0; i < threadCount; ++i) {
+				if (thread == ~0U || i == thread)
+					count += history[last].hashes[i] - history[first].hashes[i];
+			}
+			os << (w > 0 ? "," : "") << "\"" << HashrateWindows[w] << "s\":" << (elapsed > 0 ? count / elapsed : 0.0);
+		}
+		os << "}";
+	}
+
+	std::string Telemetry::toJson() {
+		Sample sample;
+		sample.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		for (unsigned i = 0; i < threadCount; ++i)
+			sample.hashes.push_back(counters[i].hashes.load(std::memory_order_relaxed));
+		history.push_back(sample);
+		while (sample.time - history.front().time > HashrateWindows[2] + 1)
+			history.pop_front();
+		uint64_t totalHashes = 0;
+		std::ostringstream os;
+		os << "{\"uptime\":" << sample.time << ",\"threads\":[";
+		for (unsigned i = 0; i < threadCount; ++i) {
+			ThreadCounters& c = counters[i];
+			uint64_t programs = c.programs.load(std::memory_order_relaxed);
+			double perProgram = programs > 0 ? 1.0 / programs : 0;
+			uint64_t histogram[LatencyBuckets], histogramTotal = 0;
+			for (int b = 0; b < LatencyBuckets; ++b) {
+				histogram[b] = c.latency[b].load(std::memory_order_relaxed);
+				histogramTotal += histogram[b];
+			}
+			totalHashes += sample.hashes[i];
+			os << (i > 0 ? "," : "") << "{\"thread\":" << i << ",\"hashes\":" << sample.hashes[i] << ",";
+			writeHashrates(os, i);
+			//percentiles are the upper bounds of the histogram buckets
+			os << ",\"latencyUs\":{";
+			const double percentiles[] = { 50, 90, 99 };
+			for (double p : percentiles) {
+				uint64_t sum = 0, rank = (uint64_t)(p / 100 * histogramTotal);
+				int b = 0;
+				while (b < LatencyBuckets - 1 && sum + histogram[b] <= rank)
+					sum += histogram[b++];
+				os << "\"p" << p << "\":" << (histogramTotal > 0 ? 2ULL << b : 0) << ",";
+			}
+			os << "\"histogram\":[";
+			for (int b = 0; b < LatencyBuckets; ++b)
+				os << (b > 0 ? "," : "") << histogram[b];
+			os << "]},\"programs\":" << programs;
+			os << ",\"compileUs\":" << c.compileTime.load(std::memory_order_relaxed) * perProgram / 1000;
+			os << ",\"codeSize\":" << c.codeBytes.load(std::memory_order_relaxed) * perProgram;
+			os << ",\"executeUs\":" << c.executeTime.load(std::memory_order_relaxed) * perProgram / 1000;
+			//dataset and scratchpad stalls dominate the time of a VM iteration
+			os << ",\"executeNsPerIteration\":" << c.executeTime.load(std::memory_order_relaxed) * perProgram / InstructionCount << "}";
+		}
+		os << "],\"total\":{\"hashes\":" << totalHashes << ",";
+		writeHashrates(os, ~0U);
+		os << "}}";
+		return os.str();
+	}
+
+}
@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace RandomX {
+
+	constexpr int LatencyBuckets = 32; //bucket i counts hashes that took [2^i, 2^(i+1)) microseconds
+
+	/*
+		Counters of one hashing thread. Only the owning thread updates them, so an
+		update is a relaxed load and store without a locked instruction, and the
+		publishing thread reads them with relaxed loads. Each set of counters has
+		its own cache lines.
+	*/
+	class alignas(64) ThreadCounters {
+	public:
+		ThreadCounters();
+		void addHash(uint64_t nanoseconds) {
+			increment(hashes, 1);
+			increment(latency[latencyBucket(nanoseconds)], 1);
+		}
+		void addProgram(uint64_t compileNanoseconds, uint64_t executeNanoseconds, uint64_t codeSize) {
+			increment(programs, 1);
+			increment(compileTime, compileNanoseconds);
+			increment(executeTime, executeNanoseconds);
+			increment(codeBytes, codeSize);
+		}
+	private:
+		friend class Telemetry;
+		std::atomic<uint64_t> hashes;
+		std::atomic<uint64_t> programs;
+		std::atomic<uint64_t> compileTime;
+		std::atomic<uint64_t> executeTime;
+		std::atomic<uint64_t> codeBytes;
+		std::atomic<uint64_t> latency[LatencyBuckets];
+
+		static void increment(std::atomic<uint64_t>& counter, uint64_t value) {
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+		static int latencyBucket(uint64_t nanoseconds) {
+			int bucket = 0;
+			for (uint64_t us = nanoseconds / 1000; us > 1 && bucket < LatencyBuckets - 1; us >>= 1)
+				bucket++;
+			return bucket;
+		}
+	};
+
+	/*
+		Publishes the counters of all hashing threads periodically as a JSON
+		document, either to a file (replaced atomically) or to the clients of a
+		Unix socket (one document per line). Hashrates are computed over sliding
+		windows of 1, 10 and 60 seconds from the samples taken at each update.
+	*/
+	class Telemetry {
+	public:
+		Telemetry(unsigned threadCount);
+		~Telemetry();
+		ThreadCounters& getCounters(unsigned thread) {
+			return counters[thread];
+		}
+		void publishToFile(const std::string& path, unsigned interval);
+		void publishToSocket(const std::string& path, unsigned interval);
+		//stops publishing after a final update
+		void stop();
+		std::string toJson();
+	private:
+		struct Sample {
+			double time;
+			std::vector<uint64_t> hashes;
+		};
+		unsigned threadCount;
+		ThreadCounters* counters;
+		std::chrono::steady_clock::time_point startTime;
+		std::deque<Sample> history;
+		std::thread publisher;
+		std::mutex mutex;
+		std::condition_variable stopped;
+		bool stopping;
+		int listenSocket;
+		std::vector<int> clients;
+		std::string filePath;
+
+		void start(unsigned interval);
+		void publish();
+		void sendToClients(const std::string& json);
+		void writeHashrates(std::ostream& os, unsigned thread);
+	};
+
+}
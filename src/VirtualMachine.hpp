@@ -37,11 +37,22 @@ namespace RandomX {
 		void resetRoundingMode();
 		virtual void initialize();
 		virtual void execute() = 0;
+		//size of the compiled program, 0 if the program is interpreted
+		virtual size_t getCodeSize() {
+			return 0;
+		}
 		template<bool softAes>
 		void getResult(void* scratchpad, size_t scratchpadSize, void* outHash);
 		const RegisterFile& getRegisterFile() {
 			return reg;
 		}
+		//restores a captured state, call after initialize()
+		void setRegisterFile(const RegisterFile& registers) {
+			reg = registers;
+		}
+		const MemoryRegisters& getMemoryRegisters() {
+			return mem;
+		}
 		Program* getProgramBuffer() {
 			return &program;
 		}
@@ -0,0 +1,50 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include <new>
+#include "VmArena.hpp"
+#include "CompiledVirtualMachine.hpp"
+#include "ScratchpadPool.hpp"
+
+namespace RandomX {
+
+	constexpr size_t ArenaVmOffset = ScratchpadSize + ScratchpadColors * ScratchpadColorStride;
+	constexpr size_t ArenaSize = ArenaVmOffset + sizeof(CompiledVirtualMachine);
+
+	VmArena::VmArena(bool largePages, uint32_t scratchpadOffset) : vm(nullptr) {
+		size = ArenaSize;
+		memory = (uint8_t*)allocPagedMemory(size, largePages, pageSize);
+		scratchpad = memory + scratchpadOffset;
+		vmMemory = memory + ArenaVmOffset;
+	}
+
+	VmArena::~VmArena() {
+		if (vm != nullptr) {
+			vm->~CompiledVirtualMachine();
+		}
+		freeLargePagesMemory(memory, size, pageSize);
+	}
+
+	CompiledVirtualMachine* VmArena::createCompiledVm(CodeRegion* codeRegion, bool dualMappedCode) {
+		if (vm == nullptr) {
+			vm = ::new(vmMemory) CompiledVirtualMachine(codeRegion, dualMappedCode);
+		}
+		return vm;
+	}
+}
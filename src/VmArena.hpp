@@ -0,0 +1,61 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include "common.hpp"
+#include "virtualMemory.hpp"
+
+namespace RandomX {
+
+	class CompiledVirtualMachine;
+	class CodeRegion;
+
+	/*
+		All per-thread hot state of a compiled VM in a single allocation.
+		The arena should be created by the thread that will use it, so that
+		the memory is NUMA-local to that thread (first-touch policy).
+
+		Layout:
+		  scratchpad      at 'scratchpadOffset' (cache color), starts a new large page
+		  VM object       registers, program buffer and memory registers (64-byte aligned)
+
+		JIT code is kept in a CodeRegion shared by all threads.
+	*/
+	class VmArena {
+	public:
+		VmArena(bool largePages, uint32_t scratchpadOffset);
+		~VmArena();
+		CompiledVirtualMachine* createCompiledVm(CodeRegion* codeRegion = nullptr, bool dualMappedCode = false);
+		uint8_t* getScratchpad() {
+			return scratchpad;
+		}
+		PageSize getPageSize() const {
+			return pageSize;
+		}
+	private:
+		uint8_t* memory;
+		size_t size;
+		PageSize pageSize;
+		uint8_t* scratchpad;
+		uint8_t* vmMemory;
+		CompiledVirtualMachine* vm;
+	};
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "codeLayout.hpp"
+#include "cpuFeatures.hpp"
+#include <cstring>
+
+namespace RandomX {
+
+	static const CodeLayout codeLayouts[] = {
+		{ "none", 0, false },
+		//JCC erratum microcode: jumps that cross or end at a 32-byte boundary are not cached in the uop cache
+		{ "skylake", 32, true },
+		//macro-fusion doesn't happen across a cache line
+		{ "icelake", 64, false },
+		//32 bytes are fetched and decoded per cycle
+		{ "zen", 32, false },
+	};
+
+	static const uint8_t skylakeModels[] = { 0x4e, 0x55, 0x5e, 0x8e, 0x9e, 0xa5, 0xa6 };
+	static const uint8_t iceLakeModels[] = { 0x6a, 0x6c, 0x7d, 0x7e, 0x8c, 0x8d, 0x8f, 0x97, 0x9a, 0xa7, 0xaa, 0xac, 0xad, 0xae, 0xb7, 0xba, 0xbe, 0xbf, 0xcf };
+
+	template<size_t N>
+	static bool contains(const uint8_t (&models)[N], unsigned model) {
+		for (size_t i = 0; i < N; ++i) {
+			if (models[i] == model)
+				return true;
+		}
+		return false;
+	}
+
+	const CodeLayout* findCodeLayout(const char* name) {
+		for (const CodeLayout& layout : codeLayouts) {
+			if (strcmp(layout.name, name) == 0)
+				return &layout;
+		}
+		return nullptr;
+	}
+
+	const CodeLayout& detectCodeLayout() {
+		char vendor[13];
+		unsigned family, model;
+		if (cpuSignature(vendor, family, model)) {
+			if (strcmp(vendor, "GenuineIntel") == 0 && family == 6) {
+				if (contains(skylakeModels, model))
+					return *findCodeLayout("skylake");
+				if (contains(iceLakeModels, model))
+					return *findCodeLayout("icelake");
+			}
+			if ((strcmp(vendor, "AuthenticAMD") == 0 || strcmp(vendor, "HygonGenuine") == 0) && family >= 0x17) {
+				return *findCodeLayout("zen");
+			}
+		}
+		return codeLayouts[0];
+	}
+
+}
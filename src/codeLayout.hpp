@@ -0,0 +1,44 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace RandomX {
+
+	/*
+		Code layout of the loop back-edge of JIT compiled programs. The loop
+		start and the epilogue are aligned to 64 bytes by the static code; the
+		compiler inserts NOP padding before the fused 'sub ebx, 1; jnz' pair and
+		the following jump so that they don't cross a branchBoundary.
+	*/
+	struct CodeLayout {
+		const char* name;
+		uint32_t branchBoundary; //0 if no padding is needed
+		bool avoidBranchEnd; //a jump must not end at the boundary either
+	};
+
+	//returns the layout profile with the given name, nullptr if there is none
+	const CodeLayout* findCodeLayout(const char* name);
+
+	//returns the layout profile that matches the CPU, the 'none' profile if unknown
+	const CodeLayout& detectCodeLayout();
+
+}
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "cpuFeatures.hpp"
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+#define HAVE_CPUID
+#endif
+
+#ifdef HAVE_CPUID
+static void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+	__cpuidex((int*)regs, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned maxLeaf() {
+	unsigned regs[4];
+	cpuid(0, 0, regs);
+	return regs[0];
+}
+#endif
+
+bool cpuHasAvx() {
+#ifdef HAVE_CPUID
+	unsigned regs[4];
+	cpuid(1, 0, regs);
+	constexpr unsigned OsXsave = 1U << 27;
+	constexpr unsigned Avx = 1U << 28;
+	if ((regs[2] & (OsXsave | Avx)) != (OsXsave | Avx))
+		return false;
+	//the OS must save the xmm and ymm registers on context switch
+#if defined(_MSC_VER)
+	unsigned long long xcr0 = _xgetbv(0);
+#else
+	unsigned eax, edx;
+	__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	unsigned long long xcr0 = ((unsigned long long)edx << 32) | eax;
+#endif
+	return (xcr0 & 6) == 6;
+#else
+	return false;
+#endif
+}
+
+bool cpuHasBmi2() {
+#ifdef HAVE_CPUID
+	if (maxLeaf() < 7)
+		return false;
+	unsigned regs[4];
+	cpuid(7, 0, regs);
+	constexpr unsigned Bmi2 = 1U << 8;
+	return (regs[1] & Bmi2) != 0;
+#else
+	return false;
+#endif
+}
+
+bool cpuSignature(char (&vendor)[13], unsigned& family, unsigned& model) {
+#ifdef HAVE_CPUID
+	unsigned regs[4];
+	cpuid(0, 0, regs);
+	memcpy(vendor + 0, &regs[1], 4);
+	memcpy(vendor + 4, &regs[3], 4);
+	memcpy(vendor + 8, &regs[2], 4);
+	vendor[12] = '\0';
+	cpuid(1, 0, regs);
+	family = (regs[0] >> 8) & 0xf;
+	model = (regs[0] >> 4) & 0xf;
+	if (family == 0xf)
+		family += (regs[0] >> 20) & 0xff;
+	if (family == 0x6 || family >= 0xf)
+		model |= ((regs[0] >> 16) & 0xf) << 4;
+	return true;
+#else
+	vendor[0] = '\0';
+	family = model = 0;
+	return false;
+#endif
+}
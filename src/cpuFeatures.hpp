@@ -0,0 +1,30 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+//returns true if the CPU and the OS support AVX, i.e. VEX encoded SSE instructions
+bool cpuHasAvx();
+
+//returns true if the CPU supports BMI2 (mulx, rorx)
+bool cpuHasBmi2();
+
+//reads the CPUID vendor string (e.g. "GenuineIntel") and the display family and model,
+//returns false if CPUID is not available
+bool cpuSignature(char (&vendor)[13], unsigned& family, unsigned& model);
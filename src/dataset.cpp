@@ -103,13 +103,14 @@ namespace RandomX {
 		aw->prepareBlock(memory.ma);
 	}
 
-	void datasetAlloc(dataset_t& ds, bool largePages) {
+	void datasetAlloc(dataset_t& ds, bool largePages, PageSize& pageSize) {
 		if (sizeof(size_t) <= 4)
 			throw std::runtime_error("Platform doesn't support enough memory for the dataset");
 		if (largePages) {
-			ds.dataset = (uint8_t*)allocLargePagesMemory(DatasetSize);
+			ds.dataset = (uint8_t*)allocLargePagesMemory(DatasetSize, pageSize);
 		}
 		else {
+			pageSize = PageSize::Normal;
 			ds.dataset = (uint8_t*)_mm_malloc(DatasetSize, 64);
 			if (ds.dataset == nullptr) {
 				throw std::runtime_error("Dataset memory allocation failed. >4 GiB of free virtual memory is needed.");
@@ -132,7 +133,7 @@ namespace RandomX {
 
 	template<bool softAes>
 	void datasetInitCache(const void* seed, dataset_t& ds, bool largePages) {
-		ds.cache = new(Cache::alloc(largePages)) Cache();
+		ds.cache = Cache::alloc(largePages);
 		ds.cache->initialize<softAes>(seed, SeedSize);
 	}
 
@@ -23,6 +23,7 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 #include <array>
 #include "intrinPortable.h"
 #include "common.hpp"
+#include "virtualMemory.hpp"
 
 namespace RandomX {
 
@@ -33,7 +34,7 @@ namespace RandomX {
 
 	void initBlock(const uint8_t* cache, uint8_t* block, uint32_t blockNumber, const KeysContainer& keys);
 
-	void datasetAlloc(dataset_t& ds, bool largePages);
+	void datasetAlloc(dataset_t& ds, bool largePages, PageSize& pageSize);
 
 	template<bool softAes>
 	void datasetInit(Cache* cache, dataset_t ds, uint32_t startBlock, uint32_t blockCount);
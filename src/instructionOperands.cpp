@@ -0,0 +1,142 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#include "instructionOperands.hpp"
+
+namespace RandomX {
+
+	constexpr uint16_t IntOp = ReadDst | WriteDst | ReadSrc;
+	constexpr uint16_t IntMemOp = IntOp | ReadMemory;
+
+	const uint16_t instructionOperands[InstructionType::NOP + 1] = {
+		IntOp,                                   //IADD_R
+		IntMemOp,                                //IADD_M
+		IntOp,                                   //IADD_RC
+		IntOp,                                   //ISUB_R
+		IntMemOp,                                //ISUB_M
+		IntOp,                                   //IMUL_9C
+		IntOp,                                   //IMUL_R
+		IntMemOp,                                //IMUL_M
+		IntOp,                                   //IMULH_R
+		IntMemOp,                                //IMULH_M
+		IntOp,                                   //ISMULH_R
+		IntMemOp,                                //ISMULH_M
+		ReadDst | WriteDst,                      //IDIV_C
+		ReadDst | WriteDst,                      //ISDIV_C
+		ReadDst | WriteDst,                      //INEG_R
+		IntOp,                                   //IXOR_R
+		IntMemOp,                                //IXOR_M
+		IntOp,                                   //IROR_R
+		IntOp,                                   //IROL_R
+		IntOp | WriteSrc,                        //ISWAP_R
+		XmmDst,                                  //FSWAP_R
+		FloatDst | ReadRounding,                 //FADD_R
+		FloatDst | ReadSrc | ReadMemory | ReadRounding, //FADD_M
+		FloatDst | ReadRounding,                 //FSUB_R
+		FloatDst | ReadSrc | ReadMemory | ReadRounding, //FSUB_M
+		FloatDst | LaneSymmetric,                //FSCAL_R
+		MulDst | ReadRounding,                   //FMUL_R
+		MulDst | ReadSrc | ReadMemory | ReadRounding, //FMUL_M
+		MulDst | ReadRounding,                   //FDIV_R
+		MulDst | ReadSrc | ReadMemory | ReadRounding, //FDIV_M
+		MulDst | ReadRounding | LaneSymmetric,   //FSQRT_R
+		IntOp,                                   //COND_R
+		IntMemOp,                                //COND_M
+		ReadSrc | WriteRounding,                 //CFROUND
+		ReadDst | ReadSrc | WriteMemory,         //ISTORE
+		ReadDst | XmmSrc | WriteMemory,          //FSTORE
+		0,                                       //NOP
+	};
+
+#include "instructionWeights.hpp"
+#define INST_TYPE(x) REPN(InstructionType::x, WT(x))
+
+	const uint8_t instructionType[256] = {
+		INST_TYPE(IADD_R)
+		INST_TYPE(IADD_M)
+		INST_TYPE(IADD_RC)
+		INST_TYPE(ISUB_R)
+		INST_TYPE(ISUB_M)
+		INST_TYPE(IMUL_9C)
+		INST_TYPE(IMUL_R)
+		INST_TYPE(IMUL_M)
+		INST_TYPE(IMULH_R)
+		INST_TYPE(IMULH_M)
+		INST_TYPE(ISMULH_R)
+		INST_TYPE(ISMULH_M)
+		INST_TYPE(IDIV_C)
+		INST_TYPE(ISDIV_C)
+		INST_TYPE(INEG_R)
+		INST_TYPE(IXOR_R)
+		INST_TYPE(IXOR_M)
+		INST_TYPE(IROR_R)
+		INST_TYPE(IROL_R)
+		INST_TYPE(ISWAP_R)
+		INST_TYPE(FSWAP_R)
+		INST_TYPE(FADD_R)
+		INST_TYPE(FADD_M)
+		INST_TYPE(FSUB_R)
+		INST_TYPE(FSUB_M)
+		INST_TYPE(FSCAL_R)
+		INST_TYPE(FMUL_R)
+		INST_TYPE(FMUL_M)
+		INST_TYPE(FDIV_R)
+		INST_TYPE(FDIV_M)
+		INST_TYPE(FSQRT_R)
+		INST_TYPE(COND_R)
+		INST_TYPE(COND_M)
+		INST_TYPE(CFROUND)
+		INST_TYPE(ISTORE)
+		INST_TYPE(FSTORE)
+		INST_TYPE(NOP)
+	};
+
+	int firstOpcode(int type) {
+		for (int opcode = 0; opcode < 256; ++opcode) {
+			if (instructionType[opcode] == type)
+				return opcode;
+		}
+		return -1;
+	}
+
+	constexpr uint32_t R(int reg) {
+		return 1U << reg;
+	}
+
+	constexpr uint32_t X(int reg) {
+		return 1U << (ResourceXmm + reg);
+	}
+
+	constexpr uint32_t Rounding = 1U << ResourceRounding;
+	constexpr uint32_t Memory = 1U << ResourceMemory;
+
+	static uint32_t select(uint16_t operands, uint16_t operand, uint32_t resources) {
+		return (operands & operand) ? resources : 0;
+	}
+
+	void getResources(const Instruction& instr, uint32_t& reads, uint32_t& writes) {
+		int dst = instr.dst, src = instr.src;
+		uint16_t op = instructionOperands[instructionType[instr.opcode]];
+		uint32_t xmm = select(op, FloatDst, X(dst % 4)) | select(op, MulDst, X(4 + dst % 4)) | select(op, XmmDst, X(dst));
+		reads = xmm | select(op, ReadDst, R(dst)) | select(op, ReadSrc, R(src)) | select(op, XmmSrc, X(src))
+			| select(op, ReadMemory, Memory) | select(op, ReadRounding, Rounding);
+		writes = xmm | select(op, WriteDst, R(dst)) | select(op, WriteSrc, R(src))
+			| select(op, WriteMemory, Memory) | select(op, WriteRounding, Rounding);
+	}
+}
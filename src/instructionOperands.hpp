@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2018 tevador
+
+This file is part of RandomX.
+
+RandomX is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+RandomX is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include "Instruction.hpp"
+
+namespace RandomX {
+
+	//registers and state read or written by an instruction
+	enum Operand : uint16_t {
+		ReadDst = 1 << 0,
+		WriteDst = 1 << 1,
+		ReadSrc = 1 << 2,
+		WriteSrc = 1 << 3,
+		ReadMemory = 1 << 4,
+		WriteMemory = 1 << 5,
+		ReadRounding = 1 << 6,
+		WriteRounding = 1 << 7,
+		FloatDst = 1 << 8, //F register dst % 4, read and written
+		MulDst = 1 << 9, //E register dst % 4, read and written
+		XmmDst = 1 << 10, //xmm dst, read and written
+		XmmSrc = 1 << 11, //xmm src, read
+		LaneSymmetric = 1 << 12, //treats both halves of the xmm register the same way
+	};
+
+	//type of each opcode
+	extern const uint8_t instructionType[256];
+
+	//dependency resources: r0-r7, xmm0-xmm7 (F and E registers), rounding mode, scratchpad
+	constexpr int ResourceXmm = 8;
+	constexpr int ResourceRounding = 16;
+	constexpr int ResourceMemory = 17;
+	constexpr int ResourceCount = 18;
+
+	//bit masks of the resources read and written by an instruction
+	//src and dst must already be reduced modulo RegistersCount
+	void getResources(const Instruction& instr, uint32_t& reads, uint32_t& writes);
+
+	//returns the lowest opcode of the given type, -1 if no opcode has that type
+	int firstOpcode(int type);
+
+	//operands of each instruction type
+	extern const uint16_t instructionOperands[InstructionType::NOP + 1];
+}
@@ -185,6 +185,23 @@ void setRoundMode(uint32_t rcflag) {
 	}
 }
 
+uint32_t getRoundMode() {
+#ifdef __SSE2__
+	return (_mm_getcsr() >> 13) & 3; //the rounding control of MXCSR uses the same encoding
+#else
+	switch (fegetround()) {
+		case FE_DOWNWARD:
+			return RoundDown;
+		case FE_UPWARD:
+			return RoundUp;
+		case FE_TOWARDZERO:
+			return RoundToZero;
+		default:
+			return RoundToNearest;
+	}
+#endif
+}
+
 bool condition(uint32_t type, uint32_t value, uint32_t imm32) {
 	switch (type & 7)
 	{
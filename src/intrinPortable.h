@@ -173,8 +173,9 @@ constexpr uint64_t signExtend2sCompl(uint32_t x) {
 	return (-1 == ~0) ? (int64_t)(int32_t)(x) : (x > INT32_MAX ? (x | 0xffffffff00000000ULL) : (uint64_t)x);
 }
 
+//loads only the 8 bytes that are converted, the last pair of a scratchpad ends at its last byte
 inline __m128d load_cvt_i32x2(const void* addr) {
-	__m128i ix = _mm_load_si128((const __m128i*)addr);
+	__m128i ix = _mm_loadl_epi64((const __m128i*)addr);
 	return _mm_cvtepi32_pd(ix);
 }
 
@@ -186,4 +187,5 @@ uint64_t rotl(uint64_t, int);
 uint64_t rotr(uint64_t, int);
 void initFpu();
 void setRoundMode(uint32_t);
+uint32_t getRoundMode();
 bool condition(uint32_t, uint32_t, uint32_t);
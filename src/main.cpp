@@ -34,16 +34,30 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 #include "dataset.hpp"
 #include "Cache.hpp"
 #include "hashAes1Rx4.hpp"
+#include "ScratchpadPool.hpp"
+#include "VmArena.hpp"
+#include "CodeRegion.hpp"
+#include "threadAffinity.hpp"
+#include "CancellationToken.hpp"
+#include "MiningJob.hpp"
+#include "JobReplayServer.hpp"
+#include "Telemetry.hpp"
+#include "PhaseTimer.hpp"
+#include "PerfJitLog.hpp"
+#include "PerfCounters.hpp"
+#include "ProgramCostModel.hpp"
+#include "ProgramCorpus.hpp"
+#include "MemoryTrace.hpp"
+#include "blockTemplate.hpp"
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <map>
 
 const uint8_t seed[32] = { 191, 182, 222, 175, 249, 89, 134, 104, 241, 68, 191, 62, 162, 166, 61, 64, 123, 191, 227, 193, 118, 60, 188, 53, 223, 133, 175, 24, 123, 230, 55, 74 };
 
-const uint8_t blockTemplate__[] = {
-		0x07, 0x07, 0xf7, 0xa4, 0xf0, 0xd6, 0x05, 0xb3, 0x03, 0x26, 0x08, 0x16, 0xba, 0x3f, 0x10, 0x90, 0x2e, 0x1a, 0x14,
-		0x5a, 0xc5, 0xfa, 0xd3, 0xaa, 0x3a, 0xf6, 0xea, 0x44, 0xc1, 0x18, 0x69, 0xdc, 0x4f, 0x85, 0x3f, 0x00, 0x2b, 0x2e,
-		0xea, 0x00, 0x00, 0x00, 0x00, 0x77, 0xb2, 0x06, 0xa0, 0x2c, 0xa5, 0xb1, 0xd4, 0xce, 0x6b, 0xbf, 0xdf, 0x0a, 0xca,
-		0xc3, 0x8b, 0xde, 0xd3, 0x4d, 0x2d, 0xcd, 0xee, 0xf9, 0x5c, 0xd2, 0x0c, 0xef, 0xc1, 0x2f, 0x61, 0xd5, 0x61, 0x09
-};
-
 void dump(const char* buffer, uint64_t count, const char* name) {
 	std::ofstream fout(name, std::ios::out | std::ios::binary);
 	fout.write(buffer, count);
@@ -77,6 +91,25 @@ void readIntOption(const char* option, int argc, char** argv, int& out, int defa
 	out = defaultValue;
 }
 
+void readUInt64Option(const char* option, int argc, char** argv, uint64_t& out, uint64_t defaultValue) {
+	for (int i = 0; i < argc - 1; ++i) {
+		if (strcmp(argv[i], option) == 0 && (out = strtoull(argv[i + 1], nullptr, 0)) > 0) {
+			return;
+		}
+	}
+	out = defaultValue;
+}
+
+void readStringOption(const char* option, int argc, char** argv, const char*& out, const char* defaultValue) {
+	for (int i = 0; i < argc - 1; ++i) {
+		if (strcmp(argv[i], option) == 0) {
+			out = argv[i + 1];
+			return;
+		}
+	}
+	out = defaultValue;
+}
+
 void readInt(int argc, char** argv, int& out, int defaultValue) {
 	for (int i = 0; i < argc; ++i) {
 		if (*argv[i] != '-' && (out = atoi(argv[i])) > 0) {
@@ -115,12 +148,53 @@ void printUsage(const char* executable) {
 	std::cout << "  --help        shows this message" << std::endl;
 	std::cout << "  --mine        mining mode: 4 GiB dataset, x86-64 compiled VM" << std::endl;
 	std::cout << "                (default: portable verification mode)" << std::endl;
-	std::cout << "  --largePages  use large pages" << std::endl;
+	std::cout << "  --largePages  use large pages (1 GiB, 2 MiB or transparent huge pages," << std::endl;
+	std::cout << "                whichever is available first)" << std::endl;
 	std::cout << "  --softAes     use software AES (default: x86 AES-NI)" << std::endl;
 	std::cout << "  --threads T   use T threads (default: 1)" << std::endl;
+	std::cout << "  --affinity M  pin thread i to the i-th CPU set in mask M (e.g. 0x5)" << std::endl;
+	std::cout << "  --noColor     don't offset the scratchpads of different threads" << std::endl;
+	std::cout << "  --noArena     don't place per-thread VM state into a single arena" << std::endl;
+	std::cout << "  --dualMap     write and execute JIT code through separate (W^X) mappings" << std::endl;
+	std::cout << "  --noCodeRegion  allocate JIT code buffers separately for each thread" << std::endl;
+	std::cout << "  --schedule    reorder JIT compiled instructions by their dependencies" << std::endl;
+	std::cout << "  --noRename    compile ISWAP_R and FSWAP_R into swap instructions" << std::endl;
+	std::cout << "  --sse2        don't use AVX and BMI2 encodings in JIT compiled code" << std::endl;
+	std::cout << "  --noPrefetch  don't prefetch the scratchpad lines of the next iteration" << std::endl;
+	std::cout << "  --layout L    JIT code layout profile: none, skylake, icelake or zen" << std::endl;
+	std::cout << "                (default: detected from the CPU model)" << std::endl;
+	std::cout << "  --costs F     instruction latencies for --schedule from the profile F" << std::endl;
+	std::cout << "                written by bin/probe (default: built-in estimates)" << std::endl;
+	std::cout << "  --costModel   estimate the cycles per iteration of N random programs" << std::endl;
+	std::cout << "                statically with the latencies of --costs" << std::endl;
 	std::cout << "  --nonces N    run N nonces (default: 1000)" << std::endl;
+	std::cout << "  --capture F   write the programs of the benchmark and their initial state" << std::endl;
+	std::cout << "                to the corpus file F, for bin/corpus" << std::endl;
+	std::cout << "  --traceMemory F  write the scratchpad and dataset accesses of the first" << std::endl;
+	std::cout << "                thread to the trace file F, for bin/memtrace (not with --mine)" << std::endl;
 	std::cout << "  --genAsm      generate x86-64 asm code for nonce N" << std::endl;
 	std::cout << "  --genNative   generate RandomX code for nonce N" << std::endl;
+	std::cout << "  --jitBench    measure the JIT compilation time of N random programs" << std::endl;
+	std::cout << "                (N is set with --nonces, --jitBench takes no value)" << std::endl;
+	std::cout << "  --jobBench    measure the latency of N job switches" << std::endl;
+	std::cout << "  --replay      hash jobs replayed by a local job server and report shares" << std::endl;
+	std::cout << "  --jobFile F   replay the jobs in file F, one per line: blob (hex)," << std::endl;
+	std::cout << "                nonce offset, target (hex)" << std::endl;
+	std::cout << "  --jobs J      replay J generated jobs (default: 10)" << std::endl;
+	std::cout << "  --jobInterval MS  switch to the next job every MS milliseconds (default: 1000)" << std::endl;
+	std::cout << "  --difficulty D  share difficulty of the generated jobs (default: 100)" << std::endl;
+	std::cout << "  --telemetry F   write per-thread telemetry as JSON to file F" << std::endl;
+	std::cout << "  --telemetrySocket S  send per-thread telemetry as JSON lines to the clients" << std::endl;
+	std::cout << "                of Unix socket S" << std::endl;
+	std::cout << "  --telemetryInterval MS  telemetry update interval (default: 1000)" << std::endl;
+	std::cout << "  --perfMap     name the JIT code regions in /tmp/perf-<pid>.map" << std::endl;
+	std::cout << "  --jitdump     write the JIT code of every program to /tmp/jit-<pid>.dump" << std::endl;
+	std::cout << "                for 'perf record -k mono' and 'perf inject --jit'" << std::endl;
+	std::cout << "  --perfMarkers add program instruction markers to the jitdump" << std::endl;
+	std::cout << "  --counters    report hardware performance counters per hash, counted over" << std::endl;
+	std::cout << "                the whole hashing thread (Linux)" << std::endl;
+	std::cout << "  --phases      print percentiles of the time spent in each phase of a hash" << std::endl;
+	std::cout << "                (requires a build with PHASE_TIMING, e.g. 'make timing')" << std::endl;
 }
 
 void generateAsm(int nonce) {
@@ -153,43 +227,328 @@ void generateNative(int nonce) {
 	std::cout << prog << std::endl;
 }
 
-void mine(RandomX::VirtualMachine* vm, std::atomic<int>& atomicNonce, AtomicHash& result, int noncesCount, int thread, uint8_t* scratchpad) {
+void benchmarkJit(int count, bool schedule, bool rename, bool sse2, bool prefetch, const RandomX::CodeLayout& layout) {
 	alignas(16) uint64_t hash[8];
 	uint8_t blockTemplate[sizeof(blockTemplate__)];
 	memcpy(blockTemplate, blockTemplate__, sizeof(blockTemplate));
-	int* noncePtr = (int*)(blockTemplate + 39);
-	int nonce = atomicNonce.fetch_add(1);
-
-	while (nonce < noncesCount) {
-		//std::cout << "Thread " << thread << " nonce " << nonce << std::endl;
-		*noncePtr = nonce;
-		blake2b(hash, sizeof(hash), blockTemplate, sizeof(blockTemplate), nullptr, 0);
-		fillAes1Rx4<false>((void*)hash, RandomX::ScratchpadSize, scratchpad);
-		vm->setScratchpad(scratchpad);
-		//dump((char*)((RandomX::CompiledVirtualMachine*)vm)->getProgram(), RandomX::CodeSize, "code-1337-jmp.txt");
-		for (int chain = 0; chain < RandomX::ChainLength - 1; ++chain) {
-			fillAes1Rx4<false>((void*)hash, sizeof(RandomX::Program), vm->getProgramBuffer());
-			vm->initialize();
-			vm->execute();
-			vm->getResult<false>(nullptr, 0, hash);
+	blake2b(hash, sizeof(hash), blockTemplate, sizeof(blockTemplate), nullptr, 0);
+	std::vector<RandomX::Program> programs(count);
+	for (int i = 0; i < count; ++i) {
+		fillAes1Rx4<false>((void*)hash, sizeof(RandomX::Program), &programs[i]);
+		hash[0] += i;
+	}
+	RandomX::JitCompilerX86 compiler;
+	compiler.setScheduling(schedule);
+	compiler.setRenaming(rename);
+	compiler.setPrefetching(prefetch);
+	compiler.setCodeLayout(layout);
+	if (sse2)
+		compiler.setInstructionSets(false, false);
+	uint64_t totalSize = 0;
+	//first pass warms up the caches and normalizes the register fields
+	for (int i = 0; i < count; ++i) {
+		compiler.generateProgram(programs[i]);
+	}
+	Stopwatch sw(true);
+	for (int i = 0; i < count; ++i) {
+		compiler.generateProgram(programs[i]);
+		totalSize += compiler.getCodeSize();
+	}
+	double elapsed = sw.getElapsed();
+	std::cout << "Compiled " << count << " programs (average size " << totalSize / count << " bytes)" << std::endl;
+	std::cout << "JIT performance: " << 1e9 * elapsed / count << " ns per program" << std::endl;
+}
+
+static void printDistribution(const char* name, std::vector<double>& values) {
+	std::sort(values.begin(), values.end());
+	double total = 0;
+	for (double value : values)
+		total += value;
+	auto percentile = [&](int p) { return values[(values.size() - 1) * p / 100]; };
+	std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1);
+	std::cout << std::setw(8) << total / values.size() << std::setw(8) << percentile(10) << std::setw(8) << percentile(50);
+	std::cout << std::setw(8) << percentile(90) << std::setw(8) << values.back() << std::endl;
+}
+
+void analyzeCosts(int count, const RandomX::InstructionCosts& costs) {
+	alignas(16) uint64_t hash[8];
+	uint8_t blockTemplate[sizeof(blockTemplate__)];
+	memcpy(blockTemplate, blockTemplate__, sizeof(blockTemplate));
+	blake2b(hash, sizeof(hash), blockTemplate, sizeof(blockTemplate), nullptr, 0);
+	RandomX::ProgramCostModel model(costs);
+	RandomX::Program program;
+	std::vector<double> criticalPath, recurrence, resource, window, windowScheduled, estimate, mlp;
+	std::map<std::string, int> bounds;
+	for (int i = 0; i < count; ++i) {
+		fillAes1Rx4<false>((void*)hash, sizeof(RandomX::Program), &program);
+		hash[0] += i;
+		RandomX::ProgramCost cost = model.analyze(program);
+		if (i == 0) {
+			std::cout << "Program 0:" << std::endl;
+			std::cout << "  critical path " << cost.criticalPath << " cycles:" << std::endl;
+			for (int pc : cost.criticalInstructions)
+				std::cout << "    " << std::setw(3) << pc << ": " << program(pc);
+			std::cout << "  loop-carried recurrence " << cost.recurrence << " cycles per iteration" << std::endl;
+			std::cout << "  resources " << cost.resource << " cycles per iteration (" << cost.resourceName << ")" << std::endl;
+			std::cout << "  in-order window " << cost.window << " cycles, scheduled " << cost.windowScheduled << " cycles" << std::endl;
+			std::cout << "  scratchpad loads L1/L2/L3 " << cost.loads[0] << "/" << cost.loads[1] << "/" << cost.loads[2];
+			std::cout << ", memory-level parallelism " << cost.mlp << std::endl;
+			std::cout << "  estimate " << cost.estimate << " cycles per iteration, bound by " << cost.bound << std::endl;
 		}
-		fillAes1Rx4<false>((void*)hash, sizeof(RandomX::Program), vm->getProgramBuffer());
+		criticalPath.push_back(cost.criticalPath);
+		recurrence.push_back(cost.recurrence);
+		resource.push_back(cost.resource);
+		window.push_back(cost.window);
+		windowScheduled.push_back(cost.windowScheduled);
+		estimate.push_back(cost.estimate);
+		mlp.push_back(cost.mlp);
+		bounds[cost.bound]++;
+	}
+	std::cout << count << " programs (cycles per iteration, ";
+	std::cout << (costs.host.empty() ? std::string("built-in costs") : "costs of " + costs.host) << "):" << std::endl;
+	std::cout << "  " << std::left << std::setw(22) << "" << std::right;
+	std::cout << std::setw(8) << "mean" << std::setw(8) << "p10" << std::setw(8) << "p50" << std::setw(8) << "p90" << std::setw(8) << "max" << std::endl;
+	printDistribution("critical path", criticalPath);
+	printDistribution("recurrence", recurrence);
+	printDistribution("resources", resource);
+	printDistribution("window", window);
+	printDistribution("window (scheduled)", windowScheduled);
+	printDistribution("estimate", estimate);
+	printDistribution("memory parallelism", mlp);
+	std::cout << "Bound by:" << std::endl;
+	for (auto& bound : bounds)
+		std::cout << "  " << std::left << std::setw(22) << bound.first << std::right << std::setw(6) << bound.second << std::endl;
+}
+
+void pinThread(int thread, int cpu) {
+	if (cpu >= 0 && !setThreadAffinity(cpu)) {
+		std::cout << "Thread " << thread << ": failed to set affinity to CPU " << cpu << std::endl;
+	}
+}
+
+static uint64_t elapsedNanoseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static void captureState(RandomX::VirtualMachine* vm, RandomX::CorpusProgram* capture) {
+	if (capture != nullptr) {
+		capture->registers = vm->getRegisterFile();
+		capture->ma = vm->getMemoryRegisters().ma;
+		capture->mx = vm->getMemoryRegisters().mx;
+		capture->roundingMode = getRoundMode();
+	}
+}
+
+void runProgram(RandomX::VirtualMachine* vm, RandomX::ThreadCounters* counters, RandomX::PhaseTimer* timer, RandomX::CorpusProgram* capture) {
+	if (capture != nullptr)
+		capture->program = *vm->getProgramBuffer();
+	if (counters == nullptr) {
 		vm->initialize();
+		timer->lap(RandomX::PhaseInitialize);
+		captureState(vm, capture);
 		vm->execute();
-		vm->getResult<false>(scratchpad, RandomX::ScratchpadSize, hash);
-		result.xorWith(hash);
-		if (RandomX::trace) {
-			std::cout << "Nonce: " << nonce << " ";
-			outputHex(std::cout, (char*)hash, sizeof(hash));
-			std::cout << std::endl;
+		timer->lap(RandomX::PhaseExecute);
+	}
+	else {
+		auto start = std::chrono::steady_clock::now();
+		vm->initialize();
+		auto compiled = std::chrono::steady_clock::now();
+		timer->lap(RandomX::PhaseInitialize);
+		captureState(vm, capture);
+		vm->execute();
+		auto end = std::chrono::steady_clock::now();
+		timer->lap(RandomX::PhaseExecute);
+		counters->addProgram(elapsedNanoseconds(start, compiled), elapsedNanoseconds(compiled, end), vm->getCodeSize());
+	}
+	if (capture != nullptr)
+		vm->getResult<false>(nullptr, 0, capture->result);
+}
+
+//returns false if the job is cancelled, which is checked between chain programs
+//'timer' must have been started
+//'capture' receives the programs of the hash and their initial state if it isn't null
+bool calculateHash(RandomX::VirtualMachine* vm, uint64_t* hash, uint8_t* scratchpad, const RandomX::CancellationToken* token, uint32_t job, RandomX::ThreadCounters* counters, RandomX::PhaseTimer* timer, RandomX::CorpusHash* capture) {
+	if (capture != nullptr) {
+		memcpy(capture->scratchpadSeed, hash, sizeof(capture->scratchpadSeed));
+		capture->programs.resize(RandomX::ChainLength);
+	}
+	fillAes1Rx4<false>((void*)hash, RandomX::ScratchpadSize, scratchpad);
+	vm->setScratchpad(scratchpad);
+	//every hash starts with round to nearest, not with the rounding mode left by the previous hash of the thread
+	vm->resetRoundingMode();
+	timer->lap(RandomX::PhaseScratchpad);
+	//dump((char*)((RandomX::CompiledVirtualMachine*)vm)->getProgram(), RandomX::CodeSize, "code-1337-jmp.txt");
+	for (int chain = 0; chain < RandomX::ChainLength - 1; ++chain) {
+		fillAes1Rx4<false>((void*)hash, sizeof(RandomX::Program), vm->getProgramBuffer());
+		timer->lap(RandomX::PhaseProgram);
+		runProgram(vm, counters, timer, capture != nullptr ? &capture->programs[chain] : nullptr);
+		vm->getResult<false>(nullptr, 0, hash);
+		timer->lap(RandomX::PhaseResult);
+		if (token != nullptr && token->isCancelled(job))
+			return false;
+	}
+	fillAes1Rx4<false>((void*)hash, sizeof(RandomX::Program), vm->getProgramBuffer());
+	timer->lap(RandomX::PhaseProgram);
+	runProgram(vm, counters, timer, capture != nullptr ? &capture->programs[RandomX::ChainLength - 1] : nullptr);
+	vm->getResult<false>(scratchpad, RandomX::ScratchpadSize, hash);
+	timer->lap(RandomX::PhaseFinalResult);
+	return true;
+}
+
+void mine(RandomX::VirtualMachine* vm, const RandomX::MiningJob& job, RandomX::NonceCounter& nonces, AtomicHash& result, int thread, uint8_t* scratchpad, int cpu, const RandomX::CancellationToken& token, RandomX::ThreadCounters* counters, RandomX::PhaseTimer* timer, RandomX::PerfCounters* perfCounters, RandomX::ProgramCorpus* corpus, RandomX::MemoryTrace* memoryTrace) {
+	pinThread(thread, cpu);
+	alignas(16) uint64_t hash[8];
+	uint64_t threadResult[4] = { 0 };
+	RandomX::CorpusHash capture;
+	std::vector<uint8_t> blob(job.blob);
+	uint32_t generation = token.snapshot();
+	if (perfCounters != nullptr)
+		perfCounters->start();
+
+	bool cancelled = false;
+	for (RandomX::NonceRange range = nonces.take(); range.start < range.end && !cancelled; range = nonces.take()) {
+		for (uint64_t nonce = range.start; nonce < range.end; ++nonce) {
+			//std::cout << "Thread " << thread << " nonce " << nonce << std::endl;
+			auto start = std::chrono::steady_clock::now();
+			timer->start();
+			job.setNonce(blob.data(), nonce);
+			blake2b(hash, sizeof(hash), blob.data(), blob.size(), nullptr, 0);
+			timer->lap(RandomX::PhaseSeed);
+			if (memoryTrace != nullptr)
+				memoryTrace->record(RandomX::AccessHashStart, 0);
+			if (!calculateHash(vm, hash, scratchpad, &token, generation, counters, timer, corpus != nullptr ? &capture : nullptr)) {
+				cancelled = true;
+				break;
+			}
+			if (corpus != nullptr)
+				corpus->add(capture);
+			if (counters != nullptr)
+				counters->addHash(elapsedNanoseconds(start, std::chrono::steady_clock::now()));
+			for (int i = 0; i < 4; ++i)
+				threadResult[i] ^= hash[i];
+			if (RandomX::trace) {
+				std::cout << "Nonce: " << nonce << " ";
+				outputHex(std::cout, (char*)hash, sizeof(hash));
+				std::cout << std::endl;
+			}
+		}
+	}
+	if (perfCounters != nullptr)
+		perfCounters->stop();
+	result.xorWith(threadResult);
+}
+
+/*
+	Hashing thread of the job replay mode. It hashes its own range of the
+	nonce space of the current job until the job changes, and submits the
+	hashes that meet the target as shares.
+*/
+void mineJobs(RandomX::VirtualMachine* vm, RandomX::JobReplayServer& server, int thread, int threadCount, uint8_t* scratchpad, int cpu, RandomX::ThreadCounters* counters, RandomX::PhaseTimer* timer, uint64_t& hashCount, uint64_t& droppedShares) {
+	pinThread(thread, cpu);
+	alignas(16) uint64_t hash[8];
+	const RandomX::CancellationToken& token = server.getToken();
+	uint64_t hashes = 0, dropped = 0;
+	while (!server.isStopped()) {
+		uint32_t generation;
+		const RandomX::MiningJob& job = server.getJob(generation);
+		std::vector<uint8_t> blob(job.blob);
+		RandomX::NonceRange range = RandomX::NonceRange::forThread(thread, threadCount, 0, 1ULL << 32);
+		for (uint64_t nonce = range.start; nonce < range.end; ++nonce) {
+			auto start = std::chrono::steady_clock::now();
+			timer->start();
+			job.setNonce(blob.data(), nonce);
+			blake2b(hash, sizeof(hash), blob.data(), blob.size(), nullptr, 0);
+			timer->lap(RandomX::PhaseSeed);
+			if (!calculateHash(vm, hash, scratchpad, &token, generation, counters, timer, nullptr))
+				break;
+			if (counters != nullptr)
+				counters->addHash(elapsedNanoseconds(start, std::chrono::steady_clock::now()));
+			hashes++;
+			if (RandomX::meetsTarget(hash, job.target)) {
+				RandomX::Share share;
+				share.jobId = job.id;
+				share.nonce = nonce;
+				memcpy(share.hash, hash, sizeof(share.hash));
+				dropped += !server.submit(share);
+			}
 		}
-		nonce = atomicNonce.fetch_add(1);
 	}
+	hashCount = hashes;
+	droppedShares = dropped;
+}
+
+/*
+	Measures the time from a job switch to the moment the hashing thread
+	notices it and starts hashing the new job. The switches happen at random
+	times. With cancellation points, the stale hash is abandoned after the
+	chain program that is running; without them, it is finished first.
+*/
+void benchmarkJobSwitch(RandomX::VirtualMachine* vm, uint8_t* scratchpad, int switchCount, bool preemptible) {
+	using clock = std::chrono::steady_clock;
+	RandomX::CancellationToken token;
+	std::atomic<bool> stop(false);
+	std::atomic<int> switchesSeen(0);
+	std::atomic<int64_t> switchTime(0);
+	std::vector<double> latencies;
+	uint64_t hashes = 0, abandoned = 0;
+	auto now = []() {
+		return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+	};
+	std::thread worker([&]() {
+		alignas(16) uint64_t hash[8];
+		uint8_t blockTemplate[sizeof(blockTemplate__)];
+		memcpy(blockTemplate, blockTemplate__, sizeof(blockTemplate));
+		int* noncePtr = (int*)(blockTemplate + 39);
+		int nonce = 0;
+		uint32_t job = token.snapshot();
+		RandomX::PhaseTimer timer;
+		while (!stop.load(std::memory_order_relaxed)) {
+			*noncePtr = nonce++;
+			blake2b(hash, sizeof(hash), blockTemplate, sizeof(blockTemplate), nullptr, 0);
+			bool finished = calculateHash(vm, hash, scratchpad, preemptible ? &token : nullptr, job, nullptr, &timer, nullptr);
+			hashes += finished;
+			if (token.isCancelled(job)) {
+				abandoned += !finished;
+				latencies.push_back((now() - switchTime.load()) / 1e6);
+				job = token.snapshot();
+				//the new job, e.g. a new block template
+				blockTemplate[0] ^= 1;
+				switchesSeen.fetch_add(1);
+			}
+		}
+	});
+	std::minstd_rand random(1);
+	for (int i = 0; i < switchCount; ++i) {
+		std::this_thread::sleep_for(std::chrono::microseconds(1000 + random() % 20000));
+		switchTime.store(now());
+		token.cancel();
+		while (switchesSeen.load() <= i) {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+	stop.store(true);
+	worker.join();
+	double total = 0, maximum = 0;
+	for (double latency : latencies) {
+		total += latency;
+		maximum = std::max(maximum, latency);
+	}
+	std::cout << (preemptible ? "Cancellation between chain programs: " : "Cancellation between nonces: ");
+	std::cout << "job switch latency " << total / switchCount << " ms average, " << maximum << " ms maximum";
+	std::cout << " (" << hashes << " hashes finished, " << abandoned << " abandoned)" << std::endl;
 }
 
 int main(int argc, char** argv) {
-	bool softAes, genAsm, miningMode, help, largePages, async, genNative;
-	int programCount, threadCount;
+	bool softAes, genAsm, miningMode, help, largePages, async, genNative, noColor, noArena, dualMap, noCodeRegion, jitBench, schedule, noRename, sse2, noPrefetch, jobBench, replay, phases, perfMap, jitdump, perfMarkers, hwCounters, costModel;
+	uint64_t affinity, difficulty;
+	const char* layoutName;
+	const char* costsFile;
+	const char* jobFile;
+	const char* telemetryFile;
+	const char* captureFile;
+	const char* memoryTraceFile;
+	const char* telemetrySocket;
+	int programCount, threadCount, jobCount, jobInterval, telemetryInterval;
 	readOption("--help", argc, argv, help);
 
 	if (help) {
@@ -205,6 +564,67 @@ int main(int argc, char** argv) {
 	readOption("--largePages", argc, argv, largePages);
 	readOption("--async", argc, argv, async);
 	readOption("--genNative", argc, argv, genNative);
+	readOption("--jitBench", argc, argv, jitBench);
+	readOption("--jobBench", argc, argv, jobBench);
+	readOption("--schedule", argc, argv, schedule);
+	readOption("--noRename", argc, argv, noRename);
+	readOption("--sse2", argc, argv, sse2);
+	readOption("--noPrefetch", argc, argv, noPrefetch);
+	readOption("--noColor", argc, argv, noColor);
+	readOption("--noArena", argc, argv, noArena);
+	readOption("--dualMap", argc, argv, dualMap);
+	readOption("--noCodeRegion", argc, argv, noCodeRegion);
+	readUInt64Option("--affinity", argc, argv, affinity, 0);
+	readStringOption("--layout", argc, argv, layoutName, nullptr);
+	readStringOption("--costs", argc, argv, costsFile, nullptr);
+	readOption("--replay", argc, argv, replay);
+	readStringOption("--jobFile", argc, argv, jobFile, nullptr);
+	readIntOption("--jobs", argc, argv, jobCount, 10);
+	readIntOption("--jobInterval", argc, argv, jobInterval, 1000);
+	readUInt64Option("--difficulty", argc, argv, difficulty, 100);
+	readStringOption("--telemetry", argc, argv, telemetryFile, nullptr);
+	readStringOption("--telemetrySocket", argc, argv, telemetrySocket, nullptr);
+	readIntOption("--telemetryInterval", argc, argv, telemetryInterval, 1000);
+	readOption("--phases", argc, argv, phases);
+	readOption("--perfMap", argc, argv, perfMap);
+	readOption("--jitdump", argc, argv, jitdump);
+	readOption("--perfMarkers", argc, argv, perfMarkers);
+	readOption("--counters", argc, argv, hwCounters);
+	readOption("--costModel", argc, argv, costModel);
+	readStringOption("--capture", argc, argv, captureFile, nullptr);
+	readStringOption("--traceMemory", argc, argv, memoryTraceFile, nullptr);
+
+	const RandomX::CodeLayout* layout = layoutName != nullptr ? RandomX::findCodeLayout(layoutName) : &RandomX::detectCodeLayout();
+	if (layout == nullptr) {
+		std::cout << "ERROR: unknown code layout '" << layoutName << "'" << std::endl;
+		return 1;
+	}
+
+	RandomX::InstructionCosts costs;
+	if (costsFile != nullptr) {
+		try {
+			costs.load(costsFile);
+		}
+		catch (std::exception& e) {
+			std::cout << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (captureFile != nullptr && (replay || jobBench)) {
+		std::cout << "ERROR: --capture records the programs of the benchmark only" << std::endl;
+		return 1;
+	}
+
+	if (memoryTraceFile != nullptr && (miningMode || replay || jobBench)) {
+		std::cout << "ERROR: --traceMemory records the interpreted VM in the benchmark only" << std::endl;
+		return 1;
+	}
+
+	if (phases && !RandomX::PhaseTimer::enabled()) {
+		std::cout << "ERROR: --phases requires a build with PHASE_TIMING ('make timing')" << std::endl;
+		return 1;
+	}
 
 	if (genAsm) {
 		generateAsm(programCount);
@@ -216,12 +636,29 @@ int main(int argc, char** argv) {
 		return 0;
 	}
 
+	if (costModel) {
+		analyzeCosts(programCount, costs);
+		return 0;
+	}
+
+	if (jitBench) {
+		benchmarkJit(programCount, schedule, !noRename, sse2, !noPrefetch, *layout);
+		return 0;
+	}
+
 	if (softAes)
 		std::cout << "Using software AES." << std::endl;
 
-	std::atomic<int> atomicNonce(0);
 	AtomicHash result;
-	std::vector<RandomX::VirtualMachine*> vms;
+	RandomX::MiningJob benchmarkJob{ 0, std::vector<uint8_t>(blockTemplate__, blockTemplate__ + sizeof(blockTemplate__)), 39, UINT64_MAX };
+	RandomX::CancellationToken cancellation;
+	std::vector<RandomX::VirtualMachine*> vms(threadCount);
+	std::vector<uint8_t*> scratchpads(threadCount);
+	std::unique_ptr<RandomX::CodeRegion> codeRegion;
+	std::unique_ptr<RandomX::PerfJitLog> perfLog;
+	std::unique_ptr<RandomX::ProgramCorpus> corpus;
+	std::unique_ptr<RandomX::MemoryTrace> memoryTrace;
+	std::vector<std::unique_ptr<RandomX::VmArena>> arenas(threadCount);
 	std::vector<std::thread> threads;
 	RandomX::dataset_t dataset;
 
@@ -246,12 +683,19 @@ int main(int argc, char** argv) {
 			outputHex(std::cout, (char*)dataset.cache->getCache(), sizeof(__m128i));
 			std::cout << std::endl;
 		}
+		if (largePages) {
+			std::cout << "Cache: using " << getPageSizeName(dataset.cache->getPageSize()) << std::endl;
+		}
 		if (!miningMode) {
 			std::cout << "Cache (256 MiB) initialized in " << sw.getElapsed() << " s" << std::endl;
 		}
 		else {
 			RandomX::Cache* cache = dataset.cache;
-			RandomX::datasetAlloc(dataset, largePages);
+			PageSize datasetPageSize;
+			RandomX::datasetAlloc(dataset, largePages, datasetPageSize);
+			if (largePages) {
+				std::cout << "Dataset: using " << getPageSizeName(datasetPageSize) << std::endl;
+			}
 			if (threadCount > 1) {
 				auto perThread = RandomX::DatasetBlockCount / threadCount;
 				auto remainder = RandomX::DatasetBlockCount % threadCount;
@@ -276,45 +720,177 @@ int main(int argc, char** argv) {
 					RandomX::datasetInit<false>(cache, dataset, 0, RandomX::DatasetBlockCount);
 				}
 			}
-			RandomX::Cache::dealloc(cache, largePages);
+			RandomX::Cache::dealloc(cache);
 			threads.clear();
 			std::cout << "Dataset (4 GiB) initialized in " << sw.getElapsed() << " s" << std::endl;
 		}
 		std::cout << "Initializing " << threadCount << " virtual machine(s)..." << std::endl;
-		for (int i = 0; i < threadCount; ++i) {
+		//an offset scratchpad doesn't fit into one 2 MiB page
+		uint32_t colorStride = noColor || largePages ? 0 : RandomX::ScratchpadColorStride;
+		RandomX::ScratchpadPool scratchpadPool(threadCount, largePages, colorStride);
+		if (miningMode && !noCodeRegion) {
+			codeRegion.reset(new RandomX::CodeRegion(threadCount, RandomX::CodeSize, largePages, dualMap));
+		}
+		if (miningMode && (perfMap || jitdump || perfMarkers)) {
+			perfLog.reset(new RandomX::PerfJitLog(jitdump, perfMarkers));
+			std::cout << "Describing JIT code in " << perfLog->getPath() << std::endl;
+		}
+		if (captureFile != nullptr) {
+			corpus.reset(new RandomX::ProgramCorpus());
+			corpus->create(captureFile, seed);
+			std::cout << "Capturing programs to " << captureFile << std::endl;
+		}
+		//VMs are created by the threads that will run them, so that their memory is NUMA-local
+		auto initThread = [&](int i) {
+			pinThread(i, getAffinityCpu(affinity, i));
 			RandomX::VirtualMachine* vm;
-			if (miningMode) {
-				vm = new RandomX::CompiledVirtualMachine();
+			if (miningMode && !noArena) {
+				arenas[i].reset(new RandomX::VmArena(largePages, RandomX::ScratchpadPool::getColorOffset(i, colorStride)));
+				RandomX::CompiledVirtualMachine* cvm = arenas[i]->createCompiledVm(codeRegion.get(), dualMap);
+				cvm->setScheduling(schedule);
+				cvm->setInstructionCosts(costs);
+				cvm->setRenaming(!noRename);
+				cvm->setPrefetching(!noPrefetch);
+				cvm->setCodeLayout(*layout);
+				cvm->setPerfLog(perfLog.get());
+				if (sse2)
+					cvm->setInstructionSets(false, false);
+				vm = cvm;
+				scratchpads[i] = arenas[i]->getScratchpad();
 			}
 			else {
-				vm = new RandomX::InterpretedVirtualMachine(softAes, async);
+				if (miningMode) {
+					RandomX::CompiledVirtualMachine* cvm = new RandomX::CompiledVirtualMachine(codeRegion.get(), dualMap);
+					cvm->setScheduling(schedule);
+					cvm->setInstructionCosts(costs);
+					cvm->setRenaming(!noRename);
+					cvm->setPrefetching(!noPrefetch);
+					cvm->setCodeLayout(*layout);
+					cvm->setPerfLog(perfLog.get());
+					if (sse2)
+						cvm->setInstructionSets(false, false);
+					vm = cvm;
+				}
+				else {
+					vm = new RandomX::InterpretedVirtualMachine(softAes, async);
+				}
+				scratchpads[i] = scratchpadPool.acquire(i);
 			}
 			vm->setDataset(dataset);
-			vms.push_back(vm);
-		}
-		uint8_t* scratchpadMem;
-		if (largePages) {
-			scratchpadMem = (uint8_t*)allocLargePagesMemory(threadCount * RandomX::ScratchpadSize);
+			vms[i] = vm;
+		};
+		if (threadCount > 1) {
+			for (int i = 0; i < threadCount; ++i) {
+				threads.push_back(std::thread(initThread, i));
+			}
+			for (unsigned i = 0; i < threads.size(); ++i) {
+				threads[i].join();
+			}
+			threads.clear();
 		}
 		else {
-			scratchpadMem = (uint8_t*)_mm_malloc(threadCount * RandomX::ScratchpadSize, RandomX::CacheLineSize);
+			initThread(0);
+		}
+		if (memoryTraceFile != nullptr) {
+			memoryTrace.reset(new RandomX::MemoryTrace());
+			memoryTrace->create(memoryTraceFile);
+			((RandomX::InterpretedVirtualMachine*)vms[0])->setMemoryTrace(memoryTrace.get());
+			std::cout << "Tracing the memory accesses of thread 0 to " << memoryTraceFile << std::endl;
+		}
+		if (miningMode && ((RandomX::CompiledVirtualMachine*)vms[0])->isCodeDualMapped()) {
+			std::cout << "JIT: using dual mapped (W^X) code buffers" << std::endl;
+		}
+		if (miningMode) {
+			std::cout << "JIT: using " << ((RandomX::CompiledVirtualMachine*)vms[0])->getInstructionSets() << " encodings" << std::endl;
+			std::cout << "JIT: using '" << ((RandomX::CompiledVirtualMachine*)vms[0])->getCodeLayoutName() << "' code layout" << std::endl;
+		}
+		if (largePages && codeRegion) {
+			std::cout << "JIT code: using " << getPageSizeName(codeRegion->getPageSize()) << std::endl;
+		}
+		if (jobBench) {
+			std::cout << "Running job switch benchmark (" << programCount << " switches) ..." << std::endl;
+			benchmarkJobSwitch(vms[0], scratchpads[0], programCount, false);
+			benchmarkJobSwitch(vms[0], scratchpads[0], programCount, true);
+			return 0;
+		}
+		std::unique_ptr<RandomX::Telemetry> telemetry;
+		if (telemetryFile != nullptr || telemetrySocket != nullptr) {
+			telemetry.reset(new RandomX::Telemetry(threadCount));
+			if (telemetrySocket != nullptr)
+				telemetry->publishToSocket(telemetrySocket, telemetryInterval);
+			else
+				telemetry->publishToFile(telemetryFile, telemetryInterval);
+		}
+		auto threadCounters = [&](int i) {
+			return telemetry ? &telemetry->getCounters(i) : nullptr;
+		};
+		std::vector<RandomX::PhaseTimer> phaseTimers(threadCount);
+		std::vector<RandomX::PerfCounters> perfCounters(hwCounters ? threadCount : 0);
+		auto threadPerfCounters = [&](int i) {
+			return hwCounters ? &perfCounters[i] : nullptr;
+		};
+		uint64_t startTicks = RandomX::PhaseTimer::ticks();
+		auto printPhases = [&](double elapsed) {
+			for (int i = 1; i < threadCount; ++i)
+				phaseTimers[0].merge(phaseTimers[i]);
+			std::cout << "Phase timing:" << std::endl;
+			phaseTimers[0].printReport(std::cout, (RandomX::PhaseTimer::ticks() - startTicks) / (elapsed * 1e9));
+		};
+		if (replay) {
+			std::vector<RandomX::MiningJob> jobs = jobFile != nullptr ? RandomX::JobReplayServer::loadJobs(jobFile) :
+				RandomX::JobReplayServer::generateJobs(blockTemplate__, sizeof(blockTemplate__), 39, RandomX::difficultyToTarget(difficulty), jobCount);
+			RandomX::JobReplayServer server(std::move(jobs));
+			std::vector<uint64_t> hashCounts(threadCount), droppedShares(threadCount);
+			std::cout << "Replaying " << server.getJobCount() << " jobs (" << jobInterval << " ms each) ..." << std::endl;
+			sw.restart();
+			startTicks = RandomX::PhaseTimer::ticks();
+			for (int i = 0; i < threadCount; ++i) {
+				threads.push_back(std::thread(&mineJobs, vms[i], std::ref(server), i, threadCount, scratchpads[i], getAffinityCpu(affinity, i), threadCounters(i), &phaseTimers[i], std::ref(hashCounts[i]), std::ref(droppedShares[i])));
+			}
+			server.run(jobInterval);
+			for (unsigned i = 0; i < threads.size(); ++i) {
+				threads[i].join();
+			}
+			double elapsed = sw.getElapsed();
+			if (telemetry)
+				telemetry->stop();
+			server.collectShares();
+			uint64_t hashes = 0, dropped = 0;
+			for (int i = 0; i < threadCount; ++i) {
+				hashes += hashCounts[i];
+				dropped += droppedShares[i];
+			}
+			std::cout << "Hashes: " << hashes << " (" << hashes / elapsed << " per second)" << std::endl;
+			std::cout << "Shares: " << server.getAccepted() << " accepted, " << server.getStale() << " stale, ";
+			std::cout << server.getRejected() << " rejected, " << dropped << " dropped" << std::endl;
+			if (phases)
+				printPhases(elapsed);
+			return 0;
 		}
 		std::cout << "Running benchmark (" << programCount << " nonces) ..." << std::endl;
+		RandomX::NonceCounter nonces(0, programCount, threadCount);
 		sw.restart();
+		startTicks = RandomX::PhaseTimer::ticks();
 		if (threadCount > 1) {
 			for (unsigned i = 0; i < vms.size(); ++i) {
-				threads.push_back(std::thread(&mine, vms[i], std::ref(atomicNonce), std::ref(result), programCount, i, scratchpadMem + RandomX::ScratchpadSize * i));
+				threads.push_back(std::thread(&mine, vms[i], std::cref(benchmarkJob), std::ref(nonces), std::ref(result), i, scratchpads[i], getAffinityCpu(affinity, i), std::cref(cancellation), threadCounters(i), &phaseTimers[i], threadPerfCounters(i), corpus.get(), i == 0 ? memoryTrace.get() : nullptr));
 			}
 			for (unsigned i = 0; i < threads.size(); ++i) {
 				threads[i].join();
 			}
 		}
 		else {
-			mine(vms[0], std::ref(atomicNonce), std::ref(result), programCount, 0, scratchpadMem);
+			mine(vms[0], benchmarkJob, nonces, result, 0, scratchpads[0], getAffinityCpu(affinity, 0), cancellation, threadCounters(0), &phaseTimers[0], threadPerfCounters(0), corpus.get(), memoryTrace.get());
 			if (miningMode)
 				std::cout << "Average program size: " << ((RandomX::CompiledVirtualMachine*)vms[0])->getTotalSize() / programCount / RandomX::ChainLength << std::endl;
 		}
 		double elapsed = sw.getElapsed();
+		if (telemetry)
+			telemetry->stop();
+		if (largePages) {
+			PageSize scratchpadPageSize = arenas[0] ? arenas[0]->getPageSize() : scratchpadPool.getPageSize(0);
+			std::cout << "Scratchpads: using " << getPageSizeName(scratchpadPageSize) << std::endl;
+		}
 		std::cout << "Calculated result: ";
 		result.print(std::cout);
 		/*if(programCount == 1000)
@@ -325,6 +901,24 @@ int main(int argc, char** argv) {
 		else {
 			std::cout << "Performance: " << programCount / elapsed << " hashes per second" << std::endl;
 		}
+		if (phases)
+			printPhases(elapsed);
+		if (hwCounters) {
+			for (int i = 1; i < threadCount; ++i)
+				perfCounters[0].merge(perfCounters[i]);
+			perfCounters[0].printReport(std::cout, programCount);
+		}
+		if (corpus && !corpus->good()) {
+			std::cout << "ERROR: cannot write to " << captureFile << std::endl;
+			return 1;
+		}
+		if (memoryTrace) {
+			memoryTrace->flush();
+			if (!memoryTrace->good()) {
+				std::cout << "ERROR: cannot write to " << memoryTraceFile << std::endl;
+				return 1;
+			}
+		}
 	}
 	catch (std::exception& e) {
 		std::cout << "ERROR: " << e.what() << std::endl;
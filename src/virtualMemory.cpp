@@ -20,6 +20,8 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 #include "virtualMemory.hpp"
 
 #include <stdexcept>
+#include <cstdint>
+#include <cstdio>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -29,6 +31,11 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 #endif
 #include <sys/types.h>
 #include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #ifndef MAP_ANONYMOUS
 #define MAP_ANONYMOUS MAP_ANON
 #endif
@@ -74,39 +81,276 @@ void setPrivilege(const char* pszPrivilege, BOOL bEnable) {
 }
 #endif
 
+constexpr std::size_t align(std::size_t pos, uint32_t align) {
+	return ((pos - 1) / align + 1) * align;
+}
+
+constexpr std::size_t PageSize2M = 2 * 1024 * 1024;
+constexpr std::size_t PageSize1G = 1024 * 1024 * 1024;
+
+//returns nullptr if the OS refuses writable and executable memory (W^X policy)
+void* tryAllocExecutableMemory(std::size_t bytes) {
+#ifdef _WIN32
+	return VirtualAlloc(nullptr, bytes, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#else
+	void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	return mem != MAP_FAILED ? mem : nullptr;
+#endif
+}
+
 void* allocExecutableMemory(std::size_t bytes) {
-	void* mem;
+	void* mem = tryAllocExecutableMemory(bytes);
+	if (mem == nullptr) {
 #ifdef _WIN32
-	mem = VirtualAlloc(nullptr, bytes, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-	if (mem == nullptr)
 		throw std::runtime_error(getErrorMessage("allocExecutableMemory - VirtualAlloc"));
 #else
-	mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-	if (mem == MAP_FAILED)
 		throw std::runtime_error("allocExecutableMemory - mmap failed");
 #endif
+	}
 	return mem;
 }
 
-constexpr std::size_t align(std::size_t pos, uint32_t align) {
-	return ((pos - 1) / align + 1) * align;
+void freeExecutableMemory(void* ptr, std::size_t bytes) {
+	if (ptr == nullptr)
+		return;
+#ifdef _WIN32
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	munmap(ptr, bytes);
+#endif
+}
+
+#ifndef _WIN32
+static int createSharedMemoryFile(std::size_t bytes, bool hugePages) {
+	int fd = -1;
+#if defined(__linux__) && defined(SYS_memfd_create)
+	fd = syscall(SYS_memfd_create, "randomx-jit", hugePages ? 5u : 1u); //MFD_CLOEXEC | MFD_HUGETLB
+	if (fd >= 0 && ftruncate(fd, bytes) != 0) {
+		close(fd);
+		return -1;
+	}
+	if (fd >= 0 || hugePages)
+		return fd;
+#endif
+	if (hugePages)
+		return -1;
+	if (fd < 0) {
+		char name[64];
+		for (int attempt = 0; fd < 0 && attempt < 16; ++attempt) {
+			snprintf(name, sizeof(name), "/randomx-jit-%ld-%d", (long)getpid(), attempt);
+			fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fd >= 0)
+				shm_unlink(name);
+		}
+	}
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, bytes) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+//maps both views of 'fd' and closes it, on failure neither view is left mapped
+static bool mapSharedMemoryFile(int fd, std::size_t bytes, void*& writable, void*& executable) {
+	writable = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	executable = mmap(nullptr, bytes, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+	close(fd);
+	if (writable == MAP_FAILED)
+		writable = nullptr;
+	if (executable == MAP_FAILED)
+		executable = nullptr;
+	if (writable == nullptr || executable == nullptr) {
+		freeDualMappedMemory(writable, executable, bytes);
+		writable = executable = nullptr;
+		return false;
+	}
+	return true;
+}
+#endif
+
+/*
+	Maps the same memory twice: 'writable' is readable and writable, 'executable'
+	is readable and executable. No page is ever writable and executable at once,
+	so this works on systems that enforce W^X without any mprotect calls.
+	With largePages, 2 MiB hugetlb pages are tried first (Linux only), and 4 KiB
+	pages are used if they cannot be mapped.
+*/
+void allocDualMappedMemory(std::size_t bytes, void*& writable, void*& executable, bool largePages, PageSize& pageSize) {
+	pageSize = PageSize::Normal;
+#ifdef _WIN32
+	HANDLE section = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_EXECUTE_READWRITE, 0, (DWORD)bytes, NULL);
+	if (section == NULL)
+		throw std::runtime_error(getErrorMessage("allocDualMappedMemory - CreateFileMapping"));
+	writable = MapViewOfFile(section, FILE_MAP_WRITE, 0, 0, bytes);
+	executable = MapViewOfFile(section, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, bytes);
+	CloseHandle(section);
+	if (writable == nullptr || executable == nullptr) {
+		freeDualMappedMemory(writable, executable, bytes);
+		throw std::runtime_error(getErrorMessage("allocDualMappedMemory - MapViewOfFile"));
+	}
+#else
+	if (largePages && bytes % PageSize2M == 0) {
+		//the memfd of an empty hugetlb pool is created, but cannot be mapped
+		int fd = createSharedMemoryFile(bytes, true);
+		if (fd >= 0 && mapSharedMemoryFile(fd, bytes, writable, executable)) {
+			pageSize = PageSize::Huge2M;
+			return;
+		}
+	}
+	int fd = createSharedMemoryFile(bytes, false);
+	if (fd < 0)
+		throw std::runtime_error("allocDualMappedMemory - unable to create a shared memory file");
+	if (!mapSharedMemoryFile(fd, bytes, writable, executable))
+		throw std::runtime_error("allocDualMappedMemory - mmap failed");
+#endif
+}
+
+void freeDualMappedMemory(void* writable, void* executable, std::size_t bytes) {
+#ifdef _WIN32
+	if (writable != nullptr)
+		UnmapViewOfFile(writable);
+	if (executable != nullptr)
+		UnmapViewOfFile(executable);
+#else
+	if (writable != nullptr)
+		munmap(writable, bytes);
+	if (executable != nullptr)
+		munmap(executable, bytes);
+#endif
+}
+
+const char* getPageSizeName(PageSize pageSize) {
+	switch (pageSize) {
+		case PageSize::Huge1G:
+			return "1 GiB pages";
+		case PageSize::Huge2M:
+			return "2 MiB pages";
+		case PageSize::Transparent:
+			return "transparent huge pages";
+		default:
+			return "4 KiB pages";
+	}
+}
+
+//all mappings except 1 GiB pages are rounded up to 2 MiB
+static std::size_t mappingSize(std::size_t bytes, PageSize pageSize) {
+	return align(bytes, pageSize == PageSize::Huge1G ? PageSize1G : PageSize2M);
+}
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+static void* mapHugePages(std::size_t bytes, int flags) {
+	void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE | flags, -1, 0);
+	return mem == MAP_FAILED ? nullptr : mem;
 }
 
-void* allocLargePagesMemory(std::size_t bytes) {
+//maps 2 MiB aligned memory, so that the kernel can back it with transparent huge pages
+static void* mapAligned2M(std::size_t bytes) {
+	std::size_t size = bytes + PageSize2M;
+	uint8_t* mem = (uint8_t*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return nullptr;
+	uint8_t* aligned = (uint8_t*)align((std::size_t)mem, PageSize2M);
+	if (aligned > mem)
+		munmap(mem, aligned - mem);
+	munmap(aligned + bytes, mem + size - (aligned + bytes));
+	return aligned;
+}
+#endif
+
+void* allocLargePagesMemory(std::size_t bytes, PageSize& pageSize) {
 	void* mem;
 #ifdef _WIN32
-	setPrivilege("SeLockMemoryPrivilege", 1);
-	mem = VirtualAlloc(NULL, align(bytes, 2 * 1024 * 1024), MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+	try {
+		setPrivilege("SeLockMemoryPrivilege", 1);
+		mem = VirtualAlloc(NULL, align(bytes, PageSize2M), MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+	}
+	catch (std::runtime_error&) {
+		mem = nullptr;
+	}
+	if (mem != nullptr) {
+		pageSize = PageSize::Huge2M;
+		return mem;
+	}
+	mem = VirtualAlloc(NULL, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 	if (mem == nullptr)
 		throw std::runtime_error(getErrorMessage("allocLargePagesMemory - VirtualAlloc"));
+	pageSize = PageSize::Normal;
+#elif defined(__APPLE__)
+	mem = mmap(nullptr, align(bytes, PageSize2M), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+	if (mem != MAP_FAILED) {
+		pageSize = PageSize::Huge2M;
+		return mem;
+	}
+	mem = mmap(nullptr, align(bytes, PageSize2M), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		throw std::runtime_error("allocLargePagesMemory - mmap failed");
+	pageSize = PageSize::Normal;
 #else
-#ifdef __APPLE__
-	mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
-#else
-	mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	//1 GiB pages are only worth it for allocations that fill at least one page
+	if (bytes >= PageSize1G && (mem = mapHugePages(align(bytes, PageSize1G), MAP_HUGE_1GB)) != nullptr) {
+		pageSize = PageSize::Huge1G;
+		return mem;
+	}
+	if ((mem = mapHugePages(align(bytes, PageSize2M), 0)) != nullptr) {
+		pageSize = PageSize::Huge2M;
+		return mem;
+	}
+	mem = mapAligned2M(align(bytes, PageSize2M));
+	if (mem == nullptr)
+		throw std::runtime_error("allocLargePagesMemory - mmap failed");
+#ifdef MADV_HUGEPAGE
+	if (madvise(mem, align(bytes, PageSize2M), MADV_HUGEPAGE) == 0) {
+		pageSize = PageSize::Transparent;
+		return mem;
+	}
+#endif
+	pageSize = PageSize::Normal;
 #endif
+	return mem;
+}
+
+void* allocPagedMemory(std::size_t bytes, bool largePages, PageSize& pageSize) {
+	if (largePages)
+		return allocLargePagesMemory(bytes, pageSize);
+	void* mem;
+#ifdef _WIN32
+	mem = VirtualAlloc(NULL, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (mem == nullptr)
+		throw std::runtime_error(getErrorMessage("allocPagedMemory - VirtualAlloc"));
+#else
+	mem = mmap(nullptr, align(bytes, PageSize2M), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (mem == MAP_FAILED)
-		throw std::runtime_error("allocLargePagesMemory - mmap failed");
+		throw std::runtime_error("allocPagedMemory - mmap failed");
 #endif
+	pageSize = PageSize::Normal;
 	return mem;
-}
\ No newline at end of file
+}
+
+//makes a page aligned range of memory executable, returns false if the OS refuses
+bool setPagesExecutable(void* ptr, std::size_t bytes) {
+#ifdef _WIN32
+	DWORD oldProtect;
+	return VirtualProtect(ptr, bytes, PAGE_EXECUTE_READWRITE, &oldProtect) != 0;
+#else
+	return mprotect(ptr, bytes, PROT_READ | PROT_WRITE | PROT_EXEC) == 0;
+#endif
+}
+
+void freeLargePagesMemory(void* ptr, std::size_t bytes, PageSize pageSize) {
+	if (ptr == nullptr)
+		return;
+#ifdef _WIN32
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	munmap(ptr, mappingSize(bytes, pageSize));
+#endif
+}
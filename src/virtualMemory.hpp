@@ -21,5 +21,21 @@ along with RandomX.  If not, see<http://www.gnu.org/licenses/>.
 
 #include <cstddef>
 
+enum class PageSize {
+	Huge1G,      //1 GiB hugetlb pages
+	Huge2M,      //2 MiB hugetlb pages
+	Transparent, //4 KiB pages with transparent huge pages requested
+	Normal       //4 KiB pages
+};
+
+const char* getPageSizeName(PageSize);
+
 void* allocExecutableMemory(std::size_t);
-void* allocLargePagesMemory(std::size_t);
\ No newline at end of file
+void* tryAllocExecutableMemory(std::size_t);
+void freeExecutableMemory(void*, std::size_t);
+void allocDualMappedMemory(std::size_t, void*& writable, void*& executable, bool largePages, PageSize&);
+void freeDualMappedMemory(void* writable, void* executable, std::size_t);
+void* allocLargePagesMemory(std::size_t, PageSize&);
+void* allocPagedMemory(std::size_t, bool largePages, PageSize&);
+void freeLargePagesMemory(void*, std::size_t, PageSize);
+bool setPagesExecutable(void*, std::size_t);
\ No newline at end of file